@@ -0,0 +1,75 @@
+#include "arena.h"
+#include <cstdlib>
+
+namespace myjson {
+
+// 单个块的上限，超过这个大小的分配单独占用一个块
+static const size_t kMaxBlockSize = 4 * 1024 * 1024;
+
+Arena::Arena(size_t block_size) : block_size(block_size ? block_size : 4096) {}
+
+Arena::~Arena() {
+    run_cleanups();
+    for (auto& b : blocks)
+        ::operator delete(b.data);
+}
+
+void* Arena::allocate_slow(size_t size, size_t align) {
+    size_t need = size + align;
+    // 优先复用reset()之后留下的块
+    while (!blocks.empty() && current + 1 < blocks.size()) {
+        Block& b = blocks[++current];
+        ptr = b.data;
+        limit = b.data + b.size;
+        if (b.size >= need)
+            return allocate(size, align);
+    }
+    // 每申请一个新块，块大小翻倍，直到kMaxBlockSize
+    size_t n = block_size;
+    if (!blocks.empty())
+        n = blocks.back().size < kMaxBlockSize ? blocks.back().size * 2 : kMaxBlockSize;
+    if (n < need)
+        n = need;
+    Block b = {static_cast<char*>(::operator new(n)), n};
+    blocks.push_back(b);
+    current = blocks.size() - 1;
+    ptr = b.data;
+    limit = b.data + b.size;
+    return allocate(size, align);
+}
+
+void Arena::add_cleanup(void* obj, void (*fn)(void*)) {
+    Cleanup* c = create<Cleanup>();
+    c->fn = fn;
+    c->obj = obj;
+    c->next = cleanups;
+    cleanups = c;
+}
+
+// 按登记的逆序析构
+void Arena::run_cleanups() {
+    for (Cleanup* c = cleanups; c; c = c->next)
+        c->fn(c->obj);
+    cleanups = nullptr;
+}
+
+void Arena::reset() {
+    run_cleanups();
+    current = 0;
+    used_bytes = 0;
+    if (blocks.empty()) {
+        ptr = limit = nullptr;
+    } else {
+        ptr = blocks[0].data;
+        limit = blocks[0].data + blocks[0].size;
+    }
+}
+
+size_t Arena::reserved() const {
+    size_t n = 0;
+    for (auto& b : blocks)
+        n += b.size;
+    return n;
+}
+
+}  // namespace myjson
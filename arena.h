@@ -0,0 +1,125 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace myjson {
+
+/*
+    Arena：简单的bump分配器。
+    内存按大块申请，每次分配只需要移动指针；块内的对象不单独释放，
+    在reset()或析构时统一回收。reset()会保留已申请的块，供下一次使用。
+    Arena不是线程安全的，一个Arena只应被一个线程使用。
+*/
+class Arena {
+public:
+    explicit Arena(size_t block_size = 64 * 1024);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(ptr) + align - 1) & ~(uintptr_t)(align - 1);
+        if (ptr != nullptr && p + size <= reinterpret_cast<uintptr_t>(limit)) {
+            ptr = reinterpret_cast<char*>(p + size);
+            used_bytes += size;
+            return reinterpret_cast<void*>(p);
+        }
+        return allocate_slow(size, align);
+    }
+
+    // 在Arena中构造对象。对象的析构函数不会被调用，除非用own()登记
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // 登记一个需要在reset()时析构的对象
+    template <typename T>
+    void own(T* obj) {
+        if (!std::is_trivially_destructible<T>::value)
+            add_cleanup(obj, &destroy<T>);
+    }
+
+    // 析构所有登记过的对象，回到第一个块重新开始分配，已申请的块保留复用
+    void reset();
+
+    size_t used() const { return used_bytes; }
+    size_t reserved() const;
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    struct Cleanup {
+        void (*fn)(void*);
+        void* obj;
+        Cleanup* next;
+    };
+
+    template <typename T>
+    static void destroy(void* p) { static_cast<T*>(p)->~T(); }
+
+    void* allocate_slow(size_t size, size_t align);
+    void add_cleanup(void* obj, void (*fn)(void*));
+    void run_cleanups();
+
+    std::vector<Block> blocks;
+    size_t current = 0;             // 当前正在使用的块
+    char* ptr = nullptr;
+    char* limit = nullptr;
+    Cleanup* cleanups = nullptr;
+    size_t block_size;
+    size_t used_bytes = 0;
+};
+
+/*
+    让标准容器从Arena取内存的分配器。
+    默认构造时arena为空，此时退化为普通的operator new/delete，
+    所以Json::array和Json::object在不使用Document时和原来的行为一致。
+*/
+template <typename T>
+class JsonAllocator {
+public:
+    typedef T value_type;
+    // 容器拷贝时不继承Arena，拷贝出来的容器总是在堆上
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::false_type propagate_on_container_move_assignment;
+    typedef std::false_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind { typedef JsonAllocator<U> other; };
+
+    JsonAllocator() noexcept : arena(nullptr) {}
+    explicit JsonAllocator(Arena* a) noexcept : arena(a) {}
+    template <typename U>
+    JsonAllocator(const JsonAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (arena)
+            return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        if (!arena)
+            ::operator delete(p);
+    }
+
+    JsonAllocator select_on_container_copy_construction() const { return JsonAllocator(); }
+
+    Arena* arena;
+};
+
+template <typename T, typename U>
+bool operator==(const JsonAllocator<T>& a, const JsonAllocator<U>& b) { return a.arena == b.arena; }
+template <typename T, typename U>
+bool operator!=(const JsonAllocator<T>& a, const JsonAllocator<U>& b) { return a.arena != b.arena; }
+
+}  // namespace myjson
@@ -0,0 +1,412 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include "myjson.h"
+#include "reader.h"
+#include "file.h"
+#include "parallel.h"
+#include "ondemand.h"
+#include "cbor.h"
+#include "bind.h"
+#include "patch.h"
+#include "schema.h"
+#include "simd.h"
+#include "writer.h"
+
+/*
+    性能测试：bench [--reps=N] [--warmup=N] [--filter=子串] [--format=text|csv|json]
+    语料由固定种子的随机数生成，每次运行都完全一样：
+        numbers  类似canada.json，大量浮点坐标
+        strings  类似twitter.json，中文、emoji、转义和嵌套的用户信息
+        nested   很深的数组和对象
+        ndjson   每行一条日志记录
+    cbor_*是同样的数据编码为CBOR之后的编码、解码和直接在CBOR上遍历。
+    每项测试先预热，再重复reps次，报告每次的平均/最小耗时、标准差和吞吐量。
+    --format=json时每项输出一行JSON，便于和之前的结果比较。
+*/
+using namespace myjson;
+
+namespace {
+
+typedef std::mt19937_64 Rng;
+
+void append_double(string& out, double d) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.15g", d);
+    out += buf;
+}
+
+string make_numbers(Rng& rng) {
+    std::uniform_real_distribution<double> lon(-141.0, -52.0), lat(41.0, 83.0);
+    string s = "{\"type\":\"FeatureCollection\",\"features\":[";
+    for (int f = 0; f < 8; f++) {
+        if (f) s += ',';
+        s += "{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+        for (int r = 0; r < 40; r++) {
+            if (r) s += ',';
+            s += '[';
+            for (int p = 0; p < 200; p++) {
+                if (p) s += ',';
+                s += '[';
+                append_double(s, lon(rng));
+                s += ',';
+                append_double(s, lat(rng));
+                s += ']';
+            }
+            s += ']';
+        }
+        s += "]}}";
+    }
+    return s + "]}";
+}
+
+string make_strings(Rng& rng) {
+    const char* words[] = {"hello", "world", "\xE4\xBD\xA0\xE5\xA5\xBD", "\xE4\xB8\x96\xE7\x95\x8C", "\xF0\x9F\x98\x80",
+                           "json", "\\u00e9t\\u00e9", "line\\nbreak", "\\\"quoted\\\"", "https:\\/\\/t.co\\/abc"};
+    string s = "{\"statuses\":[";
+    for (int t = 0; t < 2000; t++) {
+        if (t) s += ',';
+        s += "{\"id\":" + std::to_string(500000000000000000LL + t) + ",\"id_str\":\"" + std::to_string(t) + "\",\"text\":\"";
+        for (int w = 0, n = 5 + rng() % 20; w < n; w++) {
+            s += words[rng() % 10];
+            s += ' ';
+        }
+        s += "\",\"user\":{\"id\":" + std::to_string(rng() % 100000) + ",\"name\":\"" + words[rng() % 10] +
+             "\",\"screen_name\":\"user" + std::to_string(t) + "\",\"followers_count\":" + std::to_string(rng() % 10000) +
+             ",\"verified\":" + (rng() % 2 ? "true" : "false") + ",\"profile_image_url\":null}";
+        s += ",\"entities\":{\"hashtags\":[],\"urls\":[{\"url\":\"https:\\/\\/t.co\\/x\",\"indices\":[0,22]}]},";
+        s += "\"retweet_count\":" + std::to_string(rng() % 500) + ",\"lang\":\"ja\"}";
+    }
+    return s + "]}";
+}
+
+string make_nested(Rng& rng) {
+    string s = "[";
+    for (int t = 0; t < 400; t++) {
+        if (t) s += ',';
+        int depth = 20 + rng() % 80;
+        for (int d = 0; d < depth; d++)
+            s += d % 2 ? "[" : "{\"k\":";
+        s += std::to_string(t);
+        for (int d = depth; d-- > 0;)
+            s += d % 2 ? "]" : "}";
+    }
+    return s + "]";
+}
+
+string make_ndjson(Rng& rng) {
+    const char* levels[] = {"info", "warn", "error", "debug"};
+    string s;
+    for (int r = 0; r < 40000; r++) {
+        s += "{\"ts\":" + std::to_string(1700000000000LL + r * 17) + ",\"level\":\"" + levels[rng() % 4] +
+             "\",\"service\":\"api-" + std::to_string(rng() % 8) + "\",\"latency_ms\":";
+        append_double(s, (rng() % 100000) / 100.0);
+        s += ",\"path\":\"/v1/items/" + std::to_string(rng() % 1000) + "\",\"ok\":" + (rng() % 10 ? "true" : "false") + "}\n";
+    }
+    return s;
+}
+
+// 遍历所有的值，防止访问被优化掉
+double traverse(const Json& j) {
+    switch (j.type()) {
+        case Json::JSON_NUMBER: return j.number_value();
+        case Json::JSON_STRING: return static_cast<double>(j.string_view().size());
+        case Json::JSON_BOOL: return j.bool_value();
+        case Json::JSON_ARRAY: {
+            double sum = 0;
+            for (auto& e : j.array_value()) sum += traverse(e);
+            return sum;
+        }
+        case Json::JSON_OBJECT: {
+            double sum = 0;
+            for (auto& kv : j.object_value()) sum += kv.first.size() + traverse(kv.second);
+            return sum;
+        }
+        default: return 0;
+    }
+}
+
+// 同样的遍历，直接在CBOR上进行
+double traverse(const CborView& v) {
+    switch (v.type()) {
+        case Json::JSON_NUMBER: return v.number_value();
+        case Json::JSON_STRING: return static_cast<double>(v.string_view().size());
+        case Json::JSON_BOOL: return v.bool_value();
+        case Json::JSON_ARRAY:
+        case Json::JSON_OBJECT: {
+            double sum = 0;
+            for (auto it = v.begin(); it != v.end(); ++it) sum += it.key().size() + traverse(*it);
+            return sum;
+        }
+        default: return 0;
+    }
+}
+
+struct Counter {
+    size_t n = 0;
+    bool null() { n++; return true; }
+    bool boolean(bool) { n++; return true; }
+    bool number(const Number&) { n++; return true; }
+    bool string(StringView) { n++; return true; }
+    bool key(StringView) { return true; }
+    bool start_object() { return true; }
+    bool end_object(size_t) { n++; return true; }
+    bool start_array() { return true; }
+    bool end_array(size_t) { n++; return true; }
+};
+
+// strings语料的一部分字段，entities等没有列出的字段被跳过
+struct TwitterUser {
+    int64_t id;
+    string name, screen_name;
+    int followers_count;
+    bool verified;
+};
+MYJSON_BIND(TwitterUser, id, name, screen_name, followers_count, verified)
+
+struct Status {
+    int64_t id;
+    string id_str, text, lang;
+    TwitterUser user;
+    int retweet_count;
+};
+MYJSON_BIND(Status, id, id_str, text, user, retweet_count, lang)
+
+struct Timeline {
+    std::vector<Status> statuses;
+};
+MYJSON_BIND(Timeline, statuses)
+
+// 先解析为Json，再逐个字段复制到结构体中
+void copy_timeline(const Json& j, Timeline& t) {
+    t.statuses.clear();
+    for (const Json& s : j["statuses"].array_value()) {
+        Status st;
+        st.id = s["id"].int64_value();
+        st.id_str = s["id_str"].string_value();
+        st.text = s["text"].string_value();
+        st.lang = s["lang"].string_value();
+        st.retweet_count = s["retweet_count"].int_value();
+        const Json& u = s["user"];
+        st.user.id = u["id"].int64_value();
+        st.user.name = u["name"].string_value();
+        st.user.screen_name = u["screen_name"].string_value();
+        st.user.followers_count = u["followers_count"].int_value();
+        st.user.verified = u["verified"].bool_value();
+        t.statuses.push_back(std::move(st));
+    }
+}
+
+volatile double sink;
+
+struct Options {
+    int reps = 10;
+    int warmup = 2;
+    string filter;
+    string format = "text";
+};
+
+struct Result {
+    double mean_ns, min_ns, stddev_ns;
+};
+
+// 执行f（返回处理的字节数）warmup + reps次，只统计后reps次
+Result measure(const Options& opt, const std::function<size_t()>& f, size_t& bytes) {
+    for (int k = 0; k < opt.warmup; k++)
+        bytes = f();
+    std::vector<double> t;
+    for (int k = 0; k < opt.reps; k++) {
+        auto start = std::chrono::steady_clock::now();
+        bytes = f();
+        t.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+    double sum = 0, mn = t[0];
+    for (double x : t) {
+        sum += x;
+        mn = std::min(mn, x);
+    }
+    double mean = sum / t.size(), var = 0;
+    for (double x : t)
+        var += (x - mean) * (x - mean);
+    return Result{mean, mn, t.size() > 1 ? std::sqrt(var / (t.size() - 1)) : 0};
+}
+
+void report(const Options& opt, const string& name, const string& corpus, size_t bytes, const Result& r) {
+    double mbs = bytes / (r.mean_ns / 1e9) / (1 << 20);
+    if (opt.format == "json") {
+        Json::object o;
+        o["name"] = name;
+        o["corpus"] = corpus;
+        o["bytes"] = static_cast<int64_t>(bytes);
+        o["reps"] = opt.reps;
+        o["mean_ns"] = r.mean_ns;
+        o["min_ns"] = r.min_ns;
+        o["stddev_ns"] = r.stddev_ns;
+        o["mb_per_s"] = mbs;
+        o["simd"] = simd::implementation();
+        std::printf("%s\n", Json(o).dump(0, false).c_str());
+    } else if (opt.format == "csv") {
+        std::printf("%s,%s,%zu,%d,%.0f,%.0f,%.0f,%.2f\n", name.c_str(), corpus.c_str(), bytes, opt.reps, r.mean_ns,
+                    r.min_ns, r.stddev_ns, mbs);
+    } else {
+        std::printf("%-16s %-8s %10.3f ms  min %10.3f ms  sd %5.1f%%  %9.2f MB/s\n", name.c_str(), corpus.c_str(),
+                    r.mean_ns / 1e6, r.min_ns / 1e6, 100 * r.stddev_ns / r.mean_ns, mbs);
+    }
+    std::fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int k = 1; k < argc; k++) {
+        string arg = argv[k];
+        if (arg.compare(0, 7, "--reps=") == 0) opt.reps = std::max(1, std::atoi(arg.c_str() + 7));
+        else if (arg.compare(0, 9, "--warmup=") == 0) opt.warmup = std::atoi(arg.c_str() + 9);
+        else if (arg.compare(0, 9, "--filter=") == 0) opt.filter = arg.substr(9);
+        else if (arg.compare(0, 9, "--format=") == 0) opt.format = arg.substr(9);
+        else {
+            std::fprintf(stderr, "usage: %s [--reps=N] [--warmup=N] [--filter=S] [--format=text|csv|json]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (opt.format == "csv")
+        std::printf("name,corpus,bytes,reps,mean_ns,min_ns,stddev_ns,mb_per_s\n");
+
+    Rng rng(20240601);
+    struct Corpus {
+        const char* name;
+        string text;
+    } corpora[] = {{"numbers", make_numbers(rng)}, {"strings", make_strings(rng)}, {"nested", make_nested(rng)}};
+    string ndjson = make_ndjson(rng);
+
+    auto run = [&](const string& name, const string& corpus, const std::function<size_t()>& f) {
+        string full = name + "/" + corpus;
+        if (!opt.filter.empty() && full.find(opt.filter) == string::npos)
+            return;
+        size_t bytes = 0;
+        Result r = measure(opt, f, bytes);
+        report(opt, name, corpus, bytes, r);
+    };
+
+    for (auto& c : corpora) {
+        const string& in = c.text;
+        Json parsed = Json::parse(in);
+        if (parsed.state != JSON_PARSE_OK) {
+            std::fprintf(stderr, "corpus %s does not parse: %d\n", c.name, parsed.state);
+            return 1;
+        }
+        Document doc;
+        run("parse", c.name, [&]() { sink = Json::parse(in).is_null(); return in.size(); });
+        run("parse_document", c.name, [&]() { sink = doc.parse(in).is_null(); return in.size(); });
+        run("parse_sax", c.name, [&]() {
+            JsonParser parser(in);
+            Counter counter;
+            parser.parse(counter);
+            sink = counter.n;
+            return in.size();
+        });
+        run("validate", c.name, [&]() { sink = Json::validate(in); return in.size(); });
+        // 两棵独立解析的树逐个节点比较；hash第一次计算后缓存在节点中
+        Json other = Json::parse(in);
+        run("equal", c.name, [&]() { sink = parsed == other; return in.size(); });
+        run("hash_cold", c.name, [&]() { sink = Json::parse(in).hash(); return in.size(); });
+        run("hash_cached", c.name, [&]() { sink = other.hash(); return in.size(); });
+        run("traverse", c.name, [&]() { sink = traverse(parsed); return in.size(); });
+        run("dump", c.name, [&]() { string out = parsed.dump(); sink = out.size(); return out.size(); });
+        run("dump_pretty", c.name, [&]() { string out = parsed.dump(2); sink = out.size(); return out.size(); });
+
+        string cbor = encode_cbor(parsed), cbor_indexed = encode_cbor(parsed, true);
+        run("cbor_encode", c.name, [&]() { string out = encode_cbor(parsed); sink = out.size(); return out.size(); });
+        run("cbor_decode", c.name, [&]() { sink = decode_cbor(cbor).is_null(); return cbor.size(); });
+        run("cbor_view", c.name, [&]() { sink = traverse(CborView(cbor)); return cbor.size(); });
+        run("cbor_view_index", c.name, [&]() { sink = traverse(CborView(cbor_indexed)); return cbor_indexed.size(); });
+    }
+
+    Path path("/statuses/1999/user/screen_name");
+    const string& twitter = corpora[1].text;
+    run("path_extract", "strings", [&]() { sink = path.extract(twitter).string_view().size(); return twitter.size(); });
+    run("bind_copy", "strings", [&]() {
+        Timeline t;
+        copy_timeline(Json::parse(twitter), t);
+        sink = t.statuses.size();
+        return twitter.size();
+    });
+    run("bind_parse", "strings", [&]() {
+        Timeline t;
+        parse_into(twitter, t);
+        sink = t.statuses.size();
+        return twitter.size();
+    });
+    // 修改很大的文档中的几个值，写时复制只复制涉及的路径
+    Json timeline = Json::parse(twitter);
+    Json redact = Json::parse("[{\"op\": \"replace\", \"path\": \"/statuses/10/user/name\", \"value\": \"***\"},"
+                              "{\"op\": \"remove\", \"path\": \"/statuses/20/entities\"},"
+                              "{\"op\": \"add\", \"path\": \"/meta\", \"value\": {\"redacted\": true}}]");
+    run("json_patch", "strings", [&]() {
+        Json doc = timeline;
+        sink = apply_patch(doc, redact);
+        return twitter.size();
+    });
+    // 检查每条status的结构：已经解析好的Json，和边解析边检查
+    JsonSchema schema(Json::parse(
+        "{\"type\": \"object\", \"required\": [\"statuses\"], \"properties\": {\"statuses\": {\"type\": \"array\", \"items\": {"
+        "\"type\": \"object\", \"required\": [\"id\", \"text\", \"user\"], \"properties\": {"
+        "\"id\": {\"type\": \"integer\", \"minimum\": 0}, \"text\": {\"type\": \"string\", \"maxLength\": 280},"
+        "\"lang\": {\"enum\": [\"ja\", \"en\", \"zh\"]}, \"retweet_count\": {\"type\": \"integer\"},"
+        "\"user\": {\"type\": \"object\", \"required\": [\"id\", \"screen_name\"], \"properties\": {"
+        "\"screen_name\": {\"type\": \"string\", \"pattern\": \"^[a-z0-9_]+$\"}, \"verified\": {\"type\": \"boolean\"}}}}}}}}"));
+    run("schema_dom", "strings", [&]() { sink = schema.validate(timeline); return twitter.size(); });
+    run("schema_text", "strings", [&]() { sink = schema.validate_text(twitter); return twitter.size(); });
+    // 带偏移表时直接跳到第1999个元素
+    string indexed = encode_cbor(Json::parse(twitter), true);
+    run("cbor_lookup", "strings", [&]() {
+        sink = CborView(indexed)["statuses"][1999]["user"]["screen_name"].string_view().size();
+        return indexed.size();
+    });
+
+    // 导出10万条记录：先构造Json再dump，和用Writer直接输出
+    const int records = 100000;
+    run("export_dom", "records", [&]() {
+        Json::array rows;
+        for (int k = 0; k < records; k++) {
+            Json::object row;
+            row["id"] = k;
+            row["name"] = "user";
+            row["score"] = k * 0.5;
+            row["tags"] = Json::array{Json("a"), Json("b")};
+            rows.push_back(Json(std::move(row)));
+        }
+        string out = Json(std::move(rows)).dump(0, false);
+        sink = out.size();
+        return out.size();
+    });
+    run("export_writer", "records", [&]() {
+        size_t n = 0;
+        Writer w([&](const char*, size_t len) { n += len; return true; });
+        w.begin_array();
+        for (int k = 0; k < records; k++) {
+            w.begin_object().key("id").value(k).key("name").value("user").key("score").value(k * 0.5);
+            w.key("tags").begin_array().value("a").value("b").end_array().end_object();
+        }
+        w.end_array().flush();
+        sink = n;
+        return n;
+    });
+
+    run("ndjson_reader", "ndjson", [&]() {
+        NdjsonReader reader(ndjson.data(), ndjson.size());
+        Json record;
+        size_t n = 0;
+        while (reader.next(record)) n++;
+        sink = n;
+        return ndjson.size();
+    });
+    ParallelNdjson parallel;
+    run("ndjson_parallel", "ndjson", [&]() { sink = parallel.parse(ndjson.data(), ndjson.size()).size(); return ndjson.size(); });
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "bind.h"
+
+namespace myjson {
+
+/*
+    依次尝试不同的seed和表的大小，直到所有字段名落在不同的槽中。
+    字段只有几个到几十个，建表只在第一次使用时进行一次；找不到时（比如字段名重复）退回到逐个比较。
+*/
+KeyTable::KeyTable(std::vector<StringView> list) : names(std::move(list)) {
+    size_t n = names.size();
+    if (n == 0 || n >= 0xFFFF)
+        return;
+    std::vector<uint64_t> hashes;
+    for (StringView name : names)
+        hashes.push_back(Key::hash(name.data(), name.size()));
+    unsigned bits = 1;
+    while ((size_t(1) << bits) < 2 * n)
+        bits++;
+    for (unsigned last = bits + 4; bits <= last; bits++) {
+        shift = 64 - bits;
+        for (seed = 1; seed <= 256; seed++) {
+            slots.assign(size_t(1) << bits, 0);
+            size_t k = 0;
+            for (; k < n; k++) {
+                uint16_t& s = slots[slot(hashes[k])];
+                if (s)
+                    break;
+                s = static_cast<uint16_t>(k + 1);
+            }
+            if (k == n)
+                return;
+        }
+    }
+    slots.clear();
+}
+
+size_t KeyTable::find_linear(StringView key) const {
+    for (size_t k = 0; k < names.size(); k++)
+        if (names[k] == key)
+            return k;
+    return npos;
+}
+
+}  // namespace myjson
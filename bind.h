@@ -0,0 +1,454 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <type_traits>
+#include <vector>
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    类型绑定：在结构体所在的命名空间中用MYJSON_BIND列出它的字段，
+        struct User { int64_t id; string name; std::vector<string> tags; Json extra; };
+        MYJSON_BIND(User, id, name, tags, extra)
+    之后parse_into(in, user)直接从JSON文本读取到结构体中，不构造Json，也不需要第二次遍历。
+    字段的类型可以是bool、整数、浮点数、string、std::vector、key为string的std::map、
+    另一个绑定过的结构体，或者Json（不确定结构的部分照常解析为Json）。
+
+    对象的key先和下一个声明的字段比较（JSON中字段的顺序通常和声明相同），
+    不符合时再查一张在第一次使用时建立的完美哈希表，只需要一次字符串比较。
+    不认识的key被跳过，没有出现的字段保持原来的值。
+    值的类型和字段不符、整数超出字段的范围时返回JSON_PARSE_TYPE_MISMATCH，null只能读入Json。
+    输入中任何位置有语法错误时返回语法错误，而不是JSON_PARSE_TYPE_MISMATCH。
+*/
+
+/*
+    KeyTable：字段名到下标的完美哈希表，定义在bind.cpp中
+*/
+class KeyTable {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    explicit KeyTable(std::vector<StringView> names);
+    // 返回key的下标，不存在时返回npos。hint是最可能的下标
+    size_t find(StringView key, size_t hint) const {
+        if (hint < names.size() && names[hint] == key)
+            return hint;
+        if (slots.empty())
+            return find_linear(key);
+        size_t k = slots[slot(Key::hash(key.data(), key.size()))];
+        return k != 0 && names[k - 1] == key ? k - 1 : npos;
+    }
+    // 对象中的Key已经带有hash，不需要重新计算
+    size_t find(const Key& key, size_t hint) const {
+        StringView name(key.data(), key.size());
+        if (hint < names.size() && names[hint] == name)
+            return hint;
+        if (slots.empty())
+            return find_linear(name);
+        size_t k = slots[slot(key.hash())];
+        return k != 0 && names[k - 1] == name ? k - 1 : npos;
+    }
+
+private:
+    size_t slot(uint64_t hash) const { return static_cast<size_t>(((hash ^ seed) * 0x9E3779B97F4A7C15ULL) >> shift); }
+    size_t find_linear(StringView key) const;
+
+    std::vector<StringView> names;
+    std::vector<uint16_t> slots;    // 下标+1，0表示空
+    uint64_t seed = 0;
+    unsigned shift = 64;
+};
+
+template <typename T>
+struct Field {
+    const char* name;
+    bool (*read)(JsonParser& p, T& obj);
+    bool (*from)(const Json& j, T& obj);
+    Json (*to)(const T& obj);
+};
+
+template <typename T>
+class Schema {
+public:
+    Schema(std::initializer_list<Field<T>> list) : fields(list), table(names(fields)) {}
+    std::vector<Field<T>> fields;
+    KeyTable table;
+
+private:
+    static std::vector<StringView> names(const std::vector<Field<T>>& fields) {
+        std::vector<StringView> v;
+        for (auto& f : fields) v.push_back(StringView(f.name));
+        return v;
+    }
+};
+
+// 没有声明的类型在编译时报错
+template <typename T, typename Enable = void>
+struct Binder {
+    static_assert(sizeof(T) == 0, "type is not bound to JSON, use MYJSON_BIND");
+};
+
+namespace detail {
+
+// 值的类型不符，立即停止读取。输入中其他地方的语法错误由parse_into重新检查后优先报告
+inline bool mismatch(JsonParser& p) { return p.fail(false, JSON_PARSE_TYPE_MISMATCH); }
+
+// 把解析出的数字转换为整数类型T，小数部分必须为0并且不能超出T的范围
+template <typename T>
+bool to_integer(const Json& v, T& out) {
+    if (!v.is_number())
+        return false;
+    if (v.is_integer()) {
+        if (v.number_value() < 0) {
+            int64_t x = v.int64_value();
+            if (!std::is_signed<T>::value || x < static_cast<int64_t>(std::numeric_limits<T>::min()))
+                return false;
+            out = static_cast<T>(x);
+        } else {
+            uint64_t x = v.uint64_value();
+            if (x > static_cast<uint64_t>(std::numeric_limits<T>::max()))
+                return false;
+            out = static_cast<T>(x);
+        }
+        return true;
+    }
+    // 1e3这样写成小数形式的整数
+    double d = v.number_value();
+    if (!(d >= -9223372036854775808.0 && d < 18446744073709551616.0) || d != std::floor(d))
+        return false;
+    return to_integer(d < 0 ? Json(static_cast<int64_t>(d)) : Json(static_cast<uint64_t>(d)), out);
+}
+
+template <typename T, typename M, M T::*member>
+bool read_field(JsonParser& p, T& obj) { return Binder<M>::read(p, obj.*member); }
+template <typename T, typename M, M T::*member>
+bool from_field(const Json& j, T& obj) { return Binder<M>::from(j, obj.*member); }
+template <typename T, typename M, M T::*member>
+Json to_field(const T& obj) { return Binder<M>::to(obj.*member); }
+
+template <typename T, typename M, M T::*member>
+Field<T> make_field(const char* name) {
+    return Field<T>{name, &read_field<T, M, member>, &from_field<T, M, member>, &to_field<T, M, member>};
+}
+
+// 通过ADL找到MYJSON_BIND生成的myjson_schema
+template <typename T>
+struct HasSchema {
+    template <typename U>
+    static auto test(int) -> decltype(myjson_schema(static_cast<U*>(nullptr)), std::true_type());
+    template <typename U>
+    static std::false_type test(...);
+    static const bool value = decltype(test<T>(0))::value;
+};
+
+// 依次读取对象的成员，member(key)读取key对应的值
+template <typename F>
+bool read_members(JsonParser& p, F&& member) {
+    if (p.peek_token() != '{')
+        return detail::mismatch(p);
+    p.get_next_token();
+    char ch = p.get_next_token();
+    if (ch == '}')
+        return true;
+    while (true) {
+        if (ch != '"')
+            return p.fail(false, JSON_PARSE_MISS_KEY);
+        StringView key = p.parse_string_ref();
+        if (p.failed)
+            return false;
+        if (p.get_next_token() != ':')
+            return p.fail(false, JSON_PARSE_MISS_COLON);
+        if (!member(key))
+            return false;
+        ch = p.get_next_token();
+        if (ch == '}')
+            return true;
+        if (ch != ',')
+            return p.fail(false, JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET);
+        ch = p.get_next_token();
+    }
+}
+
+}  // namespace detail
+
+template <>
+struct Binder<bool> {
+    static bool read(JsonParser& p, bool& out) {
+        char ch = p.peek_token();
+        if (ch != 't' && ch != 'f')
+            return detail::mismatch(p);
+        Json v = p.parse_json();
+        if (p.failed)
+            return p.fail(false, v.state);
+        out = v.bool_value();
+        return true;
+    }
+    static bool from(const Json& j, bool& out) {
+        if (!j.is_bool())
+            return false;
+        out = j.bool_value();
+        return true;
+    }
+    static Json to(bool v) { return Json(v); }
+};
+
+template <typename T>
+struct Binder<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+    static bool read(JsonParser& p, T& out) {
+        char ch = p.peek_token();
+        if (ch != '-' && (ch < '0' || ch > '9'))
+            return detail::mismatch(p);
+        Json v = p.parse_number();
+        if (p.failed)
+            return p.fail(false, v.state);
+        return detail::to_integer(v, out) || p.fail(false, JSON_PARSE_TYPE_MISMATCH);
+    }
+    static bool from(const Json& j, T& out) { return detail::to_integer(j, out); }
+    static Json to(T v) { return std::is_signed<T>::value ? Json(static_cast<int64_t>(v)) : Json(static_cast<uint64_t>(v)); }
+};
+
+template <typename T>
+struct Binder<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static bool read(JsonParser& p, T& out) {
+        char ch = p.peek_token();
+        if (ch != '-' && (ch < '0' || ch > '9'))
+            return detail::mismatch(p);
+        Json v = p.parse_number();
+        if (p.failed)
+            return p.fail(false, v.state);
+        out = static_cast<T>(v.number_value());
+        return true;
+    }
+    static bool from(const Json& j, T& out) {
+        if (!j.is_number())
+            return false;
+        out = static_cast<T>(j.number_value());
+        return true;
+    }
+    static Json to(T v) { return Json(static_cast<double>(v)); }
+};
+
+// 字符串解码到原来的string中，可以复用它的容量
+template <>
+struct Binder<string> {
+    static bool read(JsonParser& p, string& out) {
+        if (p.peek_token() != '"')
+            return detail::mismatch(p);
+        p.get_next_token();
+        StringView s = p.parse_string_ref();
+        if (p.failed)
+            return false;
+        out.assign(s.data(), s.size());
+        return true;
+    }
+    static bool from(const Json& j, string& out) {
+        if (!j.is_string())
+            return false;
+        StringView s = j.string_view();
+        out.assign(s.data(), s.size());
+        return true;
+    }
+    static Json to(const string& v) { return Json(v); }
+};
+
+template <>
+struct Binder<Json> {
+    static bool read(JsonParser& p, Json& out) {
+        Json v = p.parse_json();
+        if (p.failed)
+            return p.fail(false, v.state);
+        out = std::move(v);
+        return true;
+    }
+    static bool from(const Json& j, Json& out) {
+        out = j;
+        return true;
+    }
+    static Json to(const Json& v) { return v; }
+};
+
+template <typename T, typename A>
+struct Binder<std::vector<T, A>> {
+    static bool read(JsonParser& p, std::vector<T, A>& out) {
+        if (p.peek_token() != '[')
+            return detail::mismatch(p);
+        p.get_next_token();
+        out.clear();
+        if (p.peek_token() == ']') {
+            p.get_next_token();
+            return true;
+        }
+        while (true) {
+            out.emplace_back();
+            if (!Binder<T>::read(p, out.back()))
+                return false;
+            char ch = p.get_next_token();
+            if (ch == ']')
+                return true;
+            if (ch != ',')
+                return p.fail(false, JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET);
+        }
+    }
+    static bool from(const Json& j, std::vector<T, A>& out) {
+        if (!j.is_array())
+            return false;
+        out.clear();
+        for (const Json& e : j.array_value()) {
+            out.emplace_back();
+            if (!Binder<T>::from(e, out.back()))
+                return false;
+        }
+        return true;
+    }
+    static Json to(const std::vector<T, A>& v) {
+        Json::array a;
+        a.reserve(v.size());
+        for (const T& e : v)
+            a.push_back(Binder<T>::to(e));
+        return Json(std::move(a));
+    }
+};
+
+template <typename V, typename C, typename A>
+struct Binder<std::map<string, V, C, A>> {
+    typedef std::map<string, V, C, A> map_type;
+    static bool read(JsonParser& p, map_type& out) {
+        out.clear();
+        return detail::read_members(p, [&](StringView key) { return Binder<V>::read(p, out[key.to_string()]); });
+    }
+    static bool from(const Json& j, map_type& out) {
+        if (!j.is_obejct())
+            return false;
+        out.clear();
+        for (auto& kv : j.object_value())
+            if (!Binder<V>::from(kv.second, out[kv.first.str()]))
+                return false;
+        return true;
+    }
+    static Json to(const map_type& v) {
+        Json::object o;
+        o.reserve(v.size());
+        for (auto& kv : v)
+            o.push_back(Json::object::value_type(Key(kv.first), Binder<V>::to(kv.second)));
+        return Json(std::move(o));
+    }
+};
+
+// 绑定过的结构体
+template <typename T>
+struct Binder<T, typename std::enable_if<detail::HasSchema<T>::value>::type> {
+    static const Schema<T>& schema() { return myjson_schema(static_cast<T*>(nullptr)); }
+
+    static bool read(JsonParser& p, T& out) {
+        const Schema<T>& s = schema();
+        size_t hint = 0;
+        return detail::read_members(p, [&](StringView key) {
+            size_t k = s.table.find(key, hint);
+            if (k == KeyTable::npos)
+                return p.skip_value();
+            hint = k + 1;
+            return s.fields[k].read(p, out);
+        });
+    }
+    static bool from(const Json& j, T& out) {
+        if (!j.is_obejct())
+            return false;
+        const Schema<T>& s = schema();
+        size_t hint = 0;
+        for (auto& kv : j.object_value()) {
+            size_t k = s.table.find(StringView(kv.first.data(), kv.first.size()), hint);
+            if (k == KeyTable::npos)
+                continue;
+            hint = k + 1;
+            if (!s.fields[k].from(kv.second, out))
+                return false;
+        }
+        return true;
+    }
+    static Json to(const T& v) {
+        const Schema<T>& s = schema();
+        Json::object o;
+        o.reserve(s.fields.size());
+        for (auto& f : s.fields)
+            o.push_back(Json::object::value_type(Key(f.name), f.to(v)));
+        return Json(std::move(o));
+    }
+};
+
+// 解析in并读取到out中，出错时out中可能只有一部分字段被更新
+template <typename T>
+State parse_into(const char* in, size_t len, T& out) {
+    JsonParser parser(in, len);
+    if (!Binder<T>::read(parser, out)) {
+        if (parser.error != JSON_PARSE_TYPE_MISMATCH)
+            return parser.error;
+        // 类型不符时还没有读完输入，只检查一遍语法，这样语法错误优先报告
+        JsonParser check(in, len);
+        if (!check.skip_value())
+            return check.error;
+        check.parse_whitespace();
+        return check.get_index() == len ? JSON_PARSE_TYPE_MISMATCH : JSON_PARSE_ROOT_NOT_SINGULAR;
+    }
+    parser.parse_whitespace();
+    return parser.get_index() == len ? JSON_PARSE_OK : JSON_PARSE_ROOT_NOT_SINGULAR;
+}
+template <typename T>
+State parse_into(const string& in, T& out) { return parse_into(in.data(), in.size(), out); }
+
+// 在已经解析出的Json和结构体之间转换
+template <typename T>
+State from_json(const Json& json, T& out) { return Binder<T>::from(json, out) ? JSON_PARSE_OK : JSON_PARSE_TYPE_MISMATCH; }
+template <typename T>
+Json to_json(const T& value) { return Binder<T>::to(value); }
+
+}  // namespace myjson
+
+// 对每个参数调用F(T, x)，最多32个
+#define MYJSON_EXPAND(x) x
+#define MYJSON_FE_1(F, T, x) F(T, x)
+#define MYJSON_FE_2(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_1(F, T, __VA_ARGS__))
+#define MYJSON_FE_3(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_2(F, T, __VA_ARGS__))
+#define MYJSON_FE_4(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_3(F, T, __VA_ARGS__))
+#define MYJSON_FE_5(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_4(F, T, __VA_ARGS__))
+#define MYJSON_FE_6(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_5(F, T, __VA_ARGS__))
+#define MYJSON_FE_7(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_6(F, T, __VA_ARGS__))
+#define MYJSON_FE_8(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_7(F, T, __VA_ARGS__))
+#define MYJSON_FE_9(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_8(F, T, __VA_ARGS__))
+#define MYJSON_FE_10(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_9(F, T, __VA_ARGS__))
+#define MYJSON_FE_11(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_10(F, T, __VA_ARGS__))
+#define MYJSON_FE_12(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_11(F, T, __VA_ARGS__))
+#define MYJSON_FE_13(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_12(F, T, __VA_ARGS__))
+#define MYJSON_FE_14(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_13(F, T, __VA_ARGS__))
+#define MYJSON_FE_15(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_14(F, T, __VA_ARGS__))
+#define MYJSON_FE_16(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_15(F, T, __VA_ARGS__))
+#define MYJSON_FE_17(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_16(F, T, __VA_ARGS__))
+#define MYJSON_FE_18(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_17(F, T, __VA_ARGS__))
+#define MYJSON_FE_19(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_18(F, T, __VA_ARGS__))
+#define MYJSON_FE_20(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_19(F, T, __VA_ARGS__))
+#define MYJSON_FE_21(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_20(F, T, __VA_ARGS__))
+#define MYJSON_FE_22(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_21(F, T, __VA_ARGS__))
+#define MYJSON_FE_23(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_22(F, T, __VA_ARGS__))
+#define MYJSON_FE_24(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_23(F, T, __VA_ARGS__))
+#define MYJSON_FE_25(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_24(F, T, __VA_ARGS__))
+#define MYJSON_FE_26(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_25(F, T, __VA_ARGS__))
+#define MYJSON_FE_27(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_26(F, T, __VA_ARGS__))
+#define MYJSON_FE_28(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_27(F, T, __VA_ARGS__))
+#define MYJSON_FE_29(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_28(F, T, __VA_ARGS__))
+#define MYJSON_FE_30(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_29(F, T, __VA_ARGS__))
+#define MYJSON_FE_31(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_30(F, T, __VA_ARGS__))
+#define MYJSON_FE_32(F, T, x, ...) F(T, x) MYJSON_EXPAND(MYJSON_FE_31(F, T, __VA_ARGS__))
+#define MYJSON_GET_FE(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, NAME, ...) NAME
+#define MYJSON_FOR_EACH(F, T, ...) \
+    MYJSON_EXPAND(MYJSON_GET_FE(__VA_ARGS__, MYJSON_FE_32, MYJSON_FE_31, MYJSON_FE_30, MYJSON_FE_29, MYJSON_FE_28, MYJSON_FE_27, MYJSON_FE_26, MYJSON_FE_25, MYJSON_FE_24, MYJSON_FE_23, MYJSON_FE_22, MYJSON_FE_21, MYJSON_FE_20, MYJSON_FE_19, MYJSON_FE_18, MYJSON_FE_17, MYJSON_FE_16, MYJSON_FE_15, MYJSON_FE_14, MYJSON_FE_13, MYJSON_FE_12, MYJSON_FE_11, MYJSON_FE_10, MYJSON_FE_9, MYJSON_FE_8, MYJSON_FE_7, MYJSON_FE_6, MYJSON_FE_5, MYJSON_FE_4, MYJSON_FE_3, MYJSON_FE_2, MYJSON_FE_1)(F, T, __VA_ARGS__))
+
+#define MYJSON_BIND_FIELD(Type, name) ::myjson::detail::make_field<Type, decltype(Type::name), &Type::name>(#name),
+
+// 在Type所在的命名空间中使用，字段名就是JSON中的key
+#define MYJSON_BIND(Type, ...)                                                                  \
+    inline const ::myjson::Schema<Type>& myjson_schema(Type*) {                                 \
+        static const ::myjson::Schema<Type> schema{MYJSON_FOR_EACH(MYJSON_BIND_FIELD, Type, __VA_ARGS__)}; \
+        return schema;                                                                          \
+    }
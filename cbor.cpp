@@ -0,0 +1,670 @@
+#include "cbor.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace myjson {
+
+/*
+    每个CBOR值以一个头开始：第一个字节的高3位是主类型，低5位是附加信息。
+    附加信息小于24时就是参数本身，24~27表示后面跟着1、2、4、8字节的大端参数，31表示不定长。
+*/
+namespace {
+
+enum Major : uint8_t { UNSIGNED, NEGATIVE, BYTES, TEXT, ARRAY, MAP, TAG, SIMPLE };
+
+const uint8_t kBreak = 0xFF;
+
+struct Head {
+    uint8_t major;
+    uint8_t info;
+    uint64_t arg;
+    bool indefinite;
+};
+
+// 读取一个头，成功时p移动到头之后
+bool read_head(const uint8_t*& p, const uint8_t* end, Head& h) {
+    if (p >= end)
+        return false;
+    uint8_t b = *p++;
+    h.major = b >> 5;
+    h.info = b & 31;
+    h.arg = h.info;
+    h.indefinite = h.info == 31;
+    if (h.info < 24)
+        return true;
+    if (h.indefinite) {
+        h.arg = 0;
+        return h.major == BYTES || h.major == TEXT || h.major == ARRAY || h.major == MAP;
+    }
+    if (h.info > 27)
+        return false;
+    size_t n = size_t(1) << (h.info - 24);
+    if (static_cast<size_t>(end - p) < n)
+        return false;
+    h.arg = 0;
+    for (size_t k = 0; k < n; k++)
+        h.arg = h.arg << 8 | p[k];
+    p += n;
+    return true;
+}
+
+// 剩下的字节是否至少有n个
+inline bool fits(const uint8_t* p, const uint8_t* end, uint64_t n) { return static_cast<uint64_t>(end - p) >= n; }
+
+uint32_t load_le32(const uint8_t* p) {
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+double to_double(uint8_t info, uint64_t bits) {
+    if (info == 27) {
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+    if (info == 26) {
+        uint32_t b = static_cast<uint32_t>(bits);
+        float f;
+        std::memcpy(&f, &b, sizeof(f));
+        return f;
+    }
+    // 半精度
+    int exp = (bits >> 10) & 0x1F;
+    int mant = bits & 0x3FF;
+    double v = exp == 0 ? std::ldexp(mant, -24)
+             : exp != 31 ? std::ldexp(mant + 1024, exp - 25)
+             : mant == 0 ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+    return bits & 0x8000 ? -v : v;
+}
+
+// 不定长字符串由若干个同类型的定长字符串组成，以kBreak结束
+template <typename F>
+bool read_chunks(const uint8_t*& p, const uint8_t* end, uint8_t major, F&& chunk) {
+    while (true) {
+        if (p >= end)
+            return false;
+        if (*p == kBreak) {
+            p++;
+            return true;
+        }
+        Head c;
+        if (!read_head(p, end, c) || c.major != major || c.indefinite || !fits(p, end, c.arg))
+            return false;
+        chunk(p, static_cast<size_t>(c.arg));
+        p += c.arg;
+    }
+}
+
+// 嵌套超过cbor_max_depth时把error设为JSON_PARSE_TOO_DEEP，其他错误由调用者按JSON_PARSE_INVALID_CBOR报告
+bool too_deep(int depth, State& error) {
+    if (depth <= cbor_max_depth)
+        return false;
+    error = JSON_PARSE_TOO_DEEP;
+    return true;
+}
+
+// 跳过一个完整的值，返回它之后的位置，出错时返回nullptr。带偏移表的容器直接跳过整个字节串
+const uint8_t* skip(const uint8_t* p, const uint8_t* end, int depth, State& error) {
+    Head h;
+    if (too_deep(depth, error) || !read_head(p, end, h))
+        return nullptr;
+    switch (h.major) {
+        case UNSIGNED:
+        case NEGATIVE:
+            return p;
+        case BYTES:
+        case TEXT:
+            if (h.indefinite)
+                return read_chunks(p, end, h.major, [](const uint8_t*, size_t) {}) ? p : nullptr;
+            return fits(p, end, h.arg) ? p + h.arg : nullptr;
+        case ARRAY:
+        case MAP: {
+            if (h.indefinite) {
+                for (uint64_t n = 0;; n++) {
+                    if (p >= end)
+                        return nullptr;
+                    if (*p == kBreak)
+                        return h.major == MAP && n % 2 ? nullptr : p + 1;
+                    if (!(p = skip(p, end, depth + 1, error)))
+                        return nullptr;
+                }
+            }
+            // 每个元素至少1个字节，先排除不可能的个数
+            if (!fits(p, end, h.arg) || (h.major == MAP && !fits(p, end, h.arg * 2)))
+                return nullptr;
+            for (uint64_t n = h.major == MAP ? h.arg * 2 : h.arg; n > 0; n--)
+                if (!(p = skip(p, end, depth + 1, error)))
+                    return nullptr;
+            return p;
+        }
+        case TAG:
+            if (h.arg == cbor_index_tag) {
+                Head b;
+                if (!read_head(p, end, b) || b.major != BYTES || b.indefinite || !fits(p, end, b.arg))
+                    return nullptr;
+                return p + b.arg;
+            }
+            return skip(p, end, depth + 1, error);
+        default:
+            return p;
+    }
+}
+
+bool decode_item(const uint8_t*& p, const uint8_t* end, int depth, Json& out, State& error);
+
+// key和字符串：定长的直接指向输入，不定长的拼接到buf中
+bool read_text(const uint8_t*& p, const uint8_t* end, const Head& h, string& buf, StringView& s) {
+    if (!h.indefinite) {
+        if (!fits(p, end, h.arg))
+            return false;
+        s = StringView(reinterpret_cast<const char*>(p), static_cast<size_t>(h.arg));
+        p += h.arg;
+        return true;
+    }
+    buf.clear();
+    if (!read_chunks(p, end, TEXT, [&](const uint8_t* c, size_t n) { buf.append(reinterpret_cast<const char*>(c), n); }))
+        return false;
+    s = StringView(buf);
+    return true;
+}
+
+// 依次解码容器的n个元素，不定长时直到kBreak为止
+template <typename F>
+bool decode_items(const uint8_t*& p, const uint8_t* end, const Head& h, F&& item) {
+    for (uint64_t k = 0; h.indefinite || k < h.arg; k++) {
+        if (h.indefinite) {
+            if (p >= end)
+                return false;
+            if (*p == kBreak) {
+                p++;
+                return true;
+            }
+        }
+        if (!item())
+            return false;
+    }
+    return true;
+}
+
+bool decode_item(const uint8_t*& p, const uint8_t* end, int depth, Json& out, State& error) {
+    Head h;
+    if (too_deep(depth, error) || !read_head(p, end, h))
+        return false;
+    switch (h.major) {
+        case UNSIGNED:
+            out = Json(h.arg);
+            return true;
+        case NEGATIVE:
+            // -1-arg，超出int64范围时只能用double表示
+            if (h.arg <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+                out = Json(-1 - static_cast<int64_t>(h.arg));
+            else
+                out = Json(-1.0 - static_cast<double>(h.arg));
+            return true;
+        case TEXT: {
+            string buf;
+            StringView s;
+            if (!read_text(p, end, h, buf, s))
+                return false;
+            out = Json(s.to_string());
+            return true;
+        }
+        case ARRAY: {
+            Json::array a;
+            if (!h.indefinite) {
+                if (!fits(p, end, h.arg))
+                    return false;
+                a.reserve(static_cast<size_t>(h.arg));
+            }
+            bool ok = decode_items(p, end, h, [&]() {
+                a.emplace_back();
+                return decode_item(p, end, depth + 1, a.back(), error);
+            });
+            out = Json(std::move(a));
+            return ok;
+        }
+        case MAP: {
+            Json::object o;
+            if (!h.indefinite) {
+                if (!fits(p, end, h.arg) || !fits(p, end, h.arg * 2))
+                    return false;
+                o.reserve(static_cast<size_t>(h.arg));
+            }
+            string buf;
+            bool ok = decode_items(p, end, h, [&]() {
+                Head k;
+                StringView key;
+                Json value;
+                if (!read_head(p, end, k) || k.major != TEXT || !read_text(p, end, k, buf, key) ||
+                    !decode_item(p, end, depth + 1, value, error))
+                    return false;
+                // 和解析JSON一样，重复的key只保留最后一个值
+                o.assign(Json::object::value_type(Key(key.data(), key.size()), std::move(value)));
+                return true;
+            });
+            out = Json(std::move(o));
+            return ok;
+        }
+        case TAG:
+            if (h.arg == cbor_index_tag) {
+                // 解码时不需要偏移表，直接解码字节串中的容器
+                Head b;
+                if (!read_head(p, end, b) || b.major != BYTES || b.indefinite || !fits(p, end, b.arg))
+                    return false;
+                const uint8_t* q = p;
+                p += b.arg;
+                return decode_item(q, p, depth + 1, out, error) && (out.is_array() || out.is_obejct());
+            }
+            return decode_item(p, end, depth + 1, out, error);
+        case SIMPLE:
+            switch (h.info) {
+                case 20: out = Json(false); return true;
+                case 21: out = Json(true); return true;
+                case 22:
+                case 23: out = Json(); return true;     // null和undefined
+                case 25:
+                case 26:
+                case 27: out = Json(to_double(h.info, h.arg)); return true;
+                default: return false;
+            }
+        default:    // 字节串
+            return false;
+    }
+}
+
+}  // namespace
+
+/*
+    CborEncoder：递归地把Json写入同一个string。
+    索引模式下先写入tag和4字节长度的字节串头，容器写完后再补上长度并追加偏移表，不需要移动已经写入的数据。
+*/
+class CborEncoder {
+public:
+    CborEncoder(string& out, bool indexed) : out(out), indexed(indexed) {}
+    void write(const Json& json);
+
+private:
+    static const size_t npos = static_cast<size_t>(-1);
+    static const size_t wrapper_size = 8;
+
+    void head(uint8_t major, uint64_t arg);
+    void write_double(double d);
+    size_t open(uint8_t major, size_t n);
+    void mark(size_t wrap) {
+        if (wrap != npos)
+            offsets.push_back(static_cast<uint32_t>(out.size() - wrap - wrapper_size));
+    }
+    void close(size_t wrap, size_t base);
+
+    string& out;
+    bool indexed;
+    // 正在写入的容器的偏移，嵌套的容器共用
+    std::vector<uint32_t> offsets;
+};
+
+void CborEncoder::head(uint8_t major, uint64_t arg) {
+    char buf[9];
+    uint8_t m = static_cast<uint8_t>(major << 5);
+    size_t n;
+    if (arg < 24) {
+        out += static_cast<char>(m | arg);
+        return;
+    }
+    if (arg <= 0xFF) { m |= 24; n = 1; }
+    else if (arg <= 0xFFFF) { m |= 25; n = 2; }
+    else if (arg <= 0xFFFFFFFF) { m |= 26; n = 4; }
+    else { m |= 27; n = 8; }
+    buf[0] = static_cast<char>(m);
+    for (size_t k = 0; k < n; k++)
+        buf[n - k] = static_cast<char>(arg >> (8 * k));
+    out.append(buf, n + 1);
+}
+
+// 能无损表示为float时用4字节，否则用8字节。NaN和无穷大也可以用float表示
+void CborEncoder::write_double(double d) {
+    if (std::isnan(d) || std::isinf(d) || (std::fabs(d) <= FLT_MAX && static_cast<double>(static_cast<float>(d)) == d)) {
+        float f = static_cast<float>(d);
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        out += static_cast<char>(SIMPLE << 5 | 26);
+        for (int k = 3; k >= 0; k--)
+            out += static_cast<char>(bits >> (8 * k));
+    } else {
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        out += static_cast<char>(SIMPLE << 5 | 27);
+        for (int k = 7; k >= 0; k--)
+            out += static_cast<char>(bits >> (8 * k));
+    }
+}
+
+size_t CborEncoder::open(uint8_t major, size_t n) {
+    size_t wrap = npos;
+    if (indexed && n >= cbor_index_min) {
+        wrap = out.size();
+        char buf[wrapper_size] = {static_cast<char>(TAG << 5 | 25), static_cast<char>(cbor_index_tag >> 8),
+                                  static_cast<char>(cbor_index_tag & 0xFF), static_cast<char>(BYTES << 5 | 26)};
+        out.append(buf, wrapper_size);
+    }
+    head(major, n);
+    return wrap;
+}
+
+void CborEncoder::close(size_t wrap, size_t base) {
+    if (wrap == npos)
+        return;
+    size_t body = wrap + wrapper_size;
+    uint64_t len = out.size() - body + 4 * (offsets.size() - base);
+    if (len > 0xFFFFFFFF) {
+        // 超过4GB的容器无法用32位偏移表示，退回到不带索引的编码
+        out.erase(wrap, wrapper_size);
+        offsets.resize(base);
+        return;
+    }
+    for (size_t k = base; k < offsets.size(); k++)
+        for (int b = 0; b < 4; b++)
+            out += static_cast<char>(offsets[k] >> (8 * b));
+    offsets.resize(base);
+    for (int b = 0; b < 4; b++)
+        out[body - 4 + b] = static_cast<char>(len >> (8 * (3 - b)));
+}
+
+void CborEncoder::write(const Json& json) {
+    switch (json.tag) {
+        case Json::TAG_NULL:
+            out += static_cast<char>(SIMPLE << 5 | 22);
+            break;
+        case Json::TAG_BOOL:
+            out += static_cast<char>(SIMPLE << 5 | (json.u.b ? 21 : 20));
+            break;
+        case Json::TAG_INT:
+            // 负数n编码为-1-n，也就是~n
+            if (json.u.i >= 0) head(UNSIGNED, json.u.ui);
+            else head(NEGATIVE, ~json.u.ui);
+            break;
+        case Json::TAG_UINT:
+            head(UNSIGNED, json.u.ui);
+            break;
+        case Json::TAG_DOUBLE:
+            write_double(json.u.d);
+            break;
+        case Json::TAG_STRING:
+        case Json::TAG_STRING_VIEW: {
+            StringView s = json.string_view();
+            head(TEXT, s.size());
+            out.append(s.data(), s.size());
+            break;
+        }
+        case Json::TAG_ARRAY: {
+            const Json::array& a = json.array_value();
+            size_t base = offsets.size();
+            size_t wrap = open(ARRAY, a.size());
+            for (const Json& e : a) {
+                mark(wrap);
+                write(e);
+            }
+            close(wrap, base);
+            break;
+        }
+        case Json::TAG_OBJECT: {
+            const Json::object& o = json.object_value();
+            size_t base = offsets.size();
+            size_t wrap = open(MAP, o.size());
+            for (auto& kv : o) {
+                mark(wrap);
+                head(TEXT, kv.first.size());
+                out.append(kv.first.data(), kv.first.size());
+                write(kv.second);
+            }
+            close(wrap, base);
+            break;
+        }
+    }
+}
+
+void encode_cbor(const Json& json, string& out, bool indexed) {
+    CborEncoder(out, indexed).write(json);
+}
+
+string encode_cbor(const Json& json, bool indexed) {
+    string out;
+    encode_cbor(json, out, indexed);
+    return out;
+}
+
+Json decode_cbor(const char* data, size_t len) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = p + len;
+    Json out;
+    State error = JSON_PARSE_INVALID_CBOR;
+    if (!decode_item(p, end, 0, out, error))
+        return Json(error);
+    if (p != end)
+        return Json(JSON_PARSE_ROOT_NOT_SINGULAR);
+    return out;
+}
+
+/*
+    CborView
+*/
+void CborView::fail(State s) {
+    error = s;
+    major = SIMPLE;
+    info = 22;
+    table = nullptr;
+}
+
+CborView CborView::missing(State s) {
+    CborView v;
+    v.error = s != JSON_PARSE_OK ? s : JSON_PARSE_PATH_NOT_FOUND;
+    return v;
+}
+
+// 跳过tag并读取头；带偏移表的容器把limit缩小到字节串的范围内
+void CborView::init(const uint8_t* p, const uint8_t* lim) {
+    start = p;
+    limit = lim;
+    table = nullptr;
+    error = JSON_PARSE_OK;
+    Head h;
+    for (int depth = 0;; depth++) {
+        item = p;
+        if (depth > cbor_max_depth)
+            return fail(JSON_PARSE_TOO_DEEP);
+        if (!read_head(p, limit, h))
+            return fail(JSON_PARSE_INVALID_CBOR);
+        if (h.major != TAG)
+            break;
+        if (h.arg == cbor_index_tag) {
+            Head b;
+            if (!read_head(p, limit, b) || b.major != BYTES || b.indefinite || !fits(p, limit, b.arg))
+                return fail(JSON_PARSE_INVALID_CBOR);
+            limit = p + b.arg;
+            item = p;
+            if (!read_head(p, limit, h) || (h.major != ARRAY && h.major != MAP) || h.indefinite ||
+                h.arg > static_cast<uint64_t>(limit - p) / 4)
+                return fail(JSON_PARSE_INVALID_CBOR);
+            table = limit - 4 * h.arg;
+            break;
+        }
+    }
+    major = h.major;
+    info = h.info;
+    arg = h.arg;
+    indefinite = h.indefinite;
+    content = p;
+    bool ok;
+    switch (major) {
+        case TEXT: ok = indefinite || fits(content, limit, arg); break;
+        case BYTES: ok = false; break;
+        case SIMPLE: ok = (info >= 20 && info <= 23) || (info >= 25 && info <= 27); break;
+        default: ok = true; break;
+    }
+    if (!ok)
+        fail(JSON_PARSE_INVALID_CBOR);
+}
+
+Json::Type CborView::type() const {
+    switch (major) {
+        case UNSIGNED:
+        case NEGATIVE: return Json::JSON_NUMBER;
+        case TEXT: return Json::JSON_STRING;
+        case ARRAY: return Json::JSON_ARRAY;
+        case MAP: return Json::JSON_OBJECT;
+        default:
+            return info == 20 || info == 21 ? Json::JSON_BOOL : info >= 25 ? Json::JSON_NUMBER : Json::JSON_NULL;
+    }
+}
+
+int64_t CborView::int64_value() const {
+    if (major == UNSIGNED) return static_cast<int64_t>(arg);
+    if (major == NEGATIVE) return static_cast<int64_t>(~arg);
+    return static_cast<int64_t>(number_value());
+}
+
+uint64_t CborView::uint64_value() const {
+    if (major == UNSIGNED || major == NEGATIVE) return static_cast<uint64_t>(int64_value());
+    return static_cast<uint64_t>(number_value());
+}
+
+double CborView::number_value() const {
+    if (major == UNSIGNED) return static_cast<double>(arg);
+    if (major == NEGATIVE) return -1.0 - static_cast<double>(arg);
+    if (major == SIMPLE && info >= 25) return to_double(info, arg);
+    return 0;
+}
+
+StringView CborView::string_view() const {
+    if (major != TEXT || indefinite)
+        return StringView();
+    return StringView(reinterpret_cast<const char*>(content), static_cast<size_t>(arg));
+}
+
+size_t CborView::size() const {
+    if (major != ARRAY && major != MAP)
+        return 0;
+    if (!indefinite)
+        return static_cast<size_t>(arg);
+    size_t n = 0;
+    for (iterator it = begin(); it != end(); ++it)
+        n++;
+    return n;
+}
+
+CborView CborView::operator[](size_t i) const {
+    if (major != ARRAY)
+        return missing(error);
+    if (table) {
+        if (i >= arg)
+            return missing(error);
+        uint32_t off = load_le32(table + 4 * i);
+        CborView v;
+        if (off >= static_cast<size_t>(table - item))
+            v.fail(JSON_PARSE_INVALID_CBOR);
+        else
+            v.init(item + off, table);
+        return v;
+    }
+    size_t k = 0;
+    for (iterator it = begin(); it != end(); ++it, ++k)
+        if (k == i || it->state() != JSON_PARSE_OK)
+            return *it;
+    return missing(error);
+}
+
+CborView CborView::operator[](StringView key) const {
+    if (major != MAP)
+        return missing(error);
+    // 和decode_cbor、Json::parse一样，重复的key以最后一个为准，所以要看完所有的成员
+    CborView found = missing(error);
+    for (iterator it = begin(); it != end(); ++it) {
+        if (it->state() != JSON_PARSE_OK)
+            return *it;
+        if (it.key() == key)
+            found = *it;
+    }
+    return found;
+}
+
+CborView::iterator CborView::begin() const {
+    iterator it;
+    if (major != ARRAY && major != MAP)
+        return it;
+    it.base = item;
+    it.end = body_end();
+    it.table = table;
+    it.object = major == MAP;
+    it.p = content;
+    it.left = indefinite ? SIZE_MAX : static_cast<size_t>(arg);
+    it.load();
+    return it;
+}
+
+void CborView::iterator::load() {
+    if (left == SIZE_MAX && p && p < end && *p == kBreak)
+        left = 0;
+    if (left == 0)
+        return;
+    if (p && object) {
+        Head h;
+        const uint8_t* q = p;
+        if (read_head(q, end, h) && h.major == TEXT && !h.indefinite && fits(q, end, h.arg)) {
+            name = StringView(reinterpret_cast<const char*>(q), static_cast<size_t>(h.arg));
+            value.init(q + h.arg, end);
+            return;
+        }
+        p = nullptr;
+    }
+    if (p)
+        value.init(p, end);
+    else
+        value.fail(JSON_PARSE_INVALID_CBOR);
+}
+
+CborView::iterator& CborView::iterator::operator++() {
+    if (!p || value.state() != JSON_PARSE_OK) {
+        left = 0;
+        return *this;
+    }
+    if (left != SIZE_MAX && --left == 0)
+        return *this;
+    k++;
+    if (table) {
+        uint32_t off = load_le32(table + 4 * k);
+        p = off < static_cast<size_t>(end - base) ? base + off : nullptr;
+    } else {
+        State s = JSON_PARSE_INVALID_CBOR;
+        if (!(p = skip(value.start, end, 0, s))) {
+            name = StringView();
+            value.fail(s);
+            return *this;
+        }
+    }
+    name = StringView();
+    load();
+    return *this;
+}
+
+StringView CborView::raw() const {
+    if (error)
+        return StringView();
+    State s;
+    const uint8_t* e = skip(start, limit, 0, s);
+    if (!e)
+        return StringView();
+    return StringView(reinterpret_cast<const char*>(start), e - start);
+}
+
+Json CborView::decode() const {
+    if (error)
+        return Json(error);
+    const uint8_t* p = start;
+    Json out;
+    State s = JSON_PARSE_INVALID_CBOR;
+    if (!decode_item(p, limit, 0, out, s))
+        return Json(s);
+    return out;
+}
+
+}  // namespace myjson
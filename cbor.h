@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    CBOR（RFC 8949）：紧凑的二进制编码。服务之间传递数据时在边界上转换一次，之后不再解析JSON文本。
+
+    encode_cbor把Json编码为标准的CBOR，任何CBOR库都能读取：整数使用最短的编码，
+    能无损表示为float的double只占5个字节，字符串和容器都是定长的（带长度前缀）。
+    decode_cbor把CBOR解码为Json，也接受不定长的字符串和容器，未知的tag被忽略；
+    JSON中没有的类型（字节串、不是字符串的key等）返回JSON_PARSE_INVALID_CBOR，
+    嵌套超过cbor_max_depth层时返回JSON_PARSE_TOO_DEEP。
+
+    索引模式：成员不少于cbor_index_min个的数组和对象额外包装为
+        tag(cbor_index_tag) 字节串( 容器本身 | 每个元素（或key）相对容器开头的偏移，uint32小端 )
+    字节串的长度使得跳过整个容器是O(1)的，偏移表使得数组的下标访问和对象的逐个key比较不需要跳过值。
+    cbor_index_tag没有注册，其他CBOR库会把它读成一个带tag的字节串，所以索引模式只用于自己的服务之间。
+*/
+const uint64_t cbor_index_tag = 0xCB1D;
+const size_t cbor_index_min = 8;
+// 解码和跳过时允许的最大嵌套深度，每层只需要1个字节，所以必须限制
+const int cbor_max_depth = 1024;
+
+void encode_cbor(const Json& json, string& out, bool indexed = false);
+string encode_cbor(const Json& json, bool indexed = false);
+
+// 输入必须恰好是一个CBOR值，后面还有数据时返回JSON_PARSE_ROOT_NOT_SINGULAR
+Json decode_cbor(const char* data, size_t len);
+inline Json decode_cbor(const string& in) { return decode_cbor(in.data(), in.size()); }
+
+/*
+    CborView：直接在CBOR缓冲区（内存中或MappedFile映射的文件）上只读地访问，不构造任何节点。
+    字符串返回指向缓冲区的StringView，缓冲区必须在使用视图期间保持有效。
+    只检查实际访问到的部分，访问出错或者成员不存在时得到的视图state()不为JSON_PARSE_OK。
+    不定长的字符串不能零拷贝访问，string_view()返回空，可以用decode()得到它。
+*/
+class CborView {
+public:
+    CborView() = default;
+    CborView(const char* data, size_t len) { init(reinterpret_cast<const uint8_t*>(data), reinterpret_cast<const uint8_t*>(data) + len); }
+    explicit CborView(const string& in) : CborView(in.data(), in.size()) {}
+
+    State state() const { return error; }
+    Json::Type type() const;
+    bool is_null() const { return type() == Json::JSON_NULL; }
+    bool is_number() const { return type() == Json::JSON_NUMBER; }
+    bool is_string() const { return type() == Json::JSON_STRING; }
+    bool is_array() const { return type() == Json::JSON_ARRAY; }
+    bool is_object() const { return type() == Json::JSON_OBJECT; }
+    // 是否带有偏移表
+    bool indexed() const { return table != nullptr; }
+
+    bool bool_value() const { return !error && major == 7 && info == 21; }
+    int64_t int64_value() const;
+    uint64_t uint64_value() const;
+    double number_value() const;
+    StringView string_view() const;
+
+    // 数组的元素个数或对象的成员个数，不定长的容器需要遍历一次
+    size_t size() const;
+    // 数组的第i个元素，带偏移表时是O(1)的
+    CborView operator[](size_t i) const;
+    // 对象中key对应的值，有重复的key时和decode_cbor一样得到最后一个
+    CborView operator[](StringView key) const;
+
+    // 遍历数组的元素或对象的值，对象的key通过iterator::key()得到
+    class iterator;
+    iterator begin() const;
+    iterator end() const;
+
+    // 这个值在缓冲区中的全部字节（包括tag），可以直接转发给别的服务
+    StringView raw() const;
+    // 构造出完整的Json
+    Json decode() const;
+
+private:
+    void init(const uint8_t* p, const uint8_t* limit);
+    void fail(State s);
+    static CborView missing(State s);
+    // 容器内容（头之后）的结尾，带偏移表时是偏移表的开头
+    const uint8_t* body_end() const { return table ? table : limit; }
+
+    const uint8_t* start = nullptr;     // 值的开头，包括tag
+    const uint8_t* item = nullptr;      // 跳过tag之后的头
+    const uint8_t* content = nullptr;   // 头之后
+    const uint8_t* limit = nullptr;     // 这个值不能超过的位置
+    const uint8_t* table = nullptr;     // 偏移表
+    uint64_t arg = 0;                   // 头中的参数：整数的值、字符串的长度或者容器的元素个数
+    uint8_t major = 7;
+    uint8_t info = 22;                  // 默认是null
+    bool indefinite = false;
+    State error = JSON_PARSE_OK;
+};
+
+// 元素有错误时得到一个state()不为JSON_PARSE_OK的值，之后遍历结束
+class CborView::iterator {
+public:
+    CborView operator*() const { return value; }
+    const CborView* operator->() const { return &value; }
+    StringView key() const { return name; }
+    iterator& operator++();
+    bool operator==(const iterator& other) const { return left == other.left; }
+    bool operator!=(const iterator& other) const { return left != other.left; }
+
+private:
+    friend class CborView;
+    void load();
+
+    const uint8_t* base = nullptr;  // 容器的头，偏移表中的偏移相对于它
+    const uint8_t* end = nullptr;   // 容器内容的结尾
+    const uint8_t* table = nullptr;
+    bool object = false;
+    const uint8_t* p = nullptr;     // 当前成员的开头，对象中是key的位置
+    size_t k = 0;                   // 当前成员的序号
+    size_t left = 0;                // 剩下的成员个数，不定长的容器在遇到结束标记之前为SIZE_MAX
+    StringView name;
+    CborView value;
+};
+
+inline CborView::iterator CborView::end() const { return iterator(); }
+
+}  // namespace myjson
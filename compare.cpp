@@ -0,0 +1,247 @@
+#include "myjson.h"
+#include <algorithm>
+#include <vector>
+
+namespace myjson {
+
+/*
+    Json的相等、排序和hash。三者必须一致：相等的值hash相同，排序时比较结果为0。
+    数字按照数学上的值比较，整数和double之间不经过double转换，所以大整数也是精确的；
+    NaN和自己相等，排在所有数字之后。
+*/
+class Comparator {
+public:
+    static bool equal(const Json& a, const Json& b);
+    static int compare(const Json& a, const Json& b);
+    static uint64_t hash(const Json& j);
+
+private:
+    static int compare_integers(const Json& a, const Json& b);
+    static int compare_double(double d, const Json& n);
+    static int compare_numbers(const Json& a, const Json& b);
+    static int compare_objects(const Json::object& x, const Json::object& y);
+    static uint64_t hash_number(const Json& j);
+    static uint64_t compute_hash(const Json& j);
+    // 两个值的hash都已经缓存并且不同时一定不相等
+    static bool known_different(const Json& a, const Json& b) {
+        uint64_t x = a.u.p->hash_code.load(std::memory_order_relaxed);
+        uint64_t y = b.u.p->hash_code.load(std::memory_order_relaxed);
+        return x && y && x != y;
+    }
+};
+
+namespace {
+
+const double two63 = 9223372036854775808.0;
+
+// MurmurHash3的最后一步，把组合起来的hash充分打散
+inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+template <typename T>
+inline int three_way(const T& a, const T& b) {
+    return a < b ? -1 : b < a ? 1 : 0;
+}
+
+}  // namespace
+
+// TAG_UINT只保存超过int64范围的值，所以总是大于TAG_INT
+int Comparator::compare_integers(const Json& a, const Json& b) {
+    if (a.tag != b.tag)
+        return a.tag == Json::TAG_UINT ? 1 : -1;
+    return a.tag == Json::TAG_UINT ? three_way(a.u.ui, b.u.ui) : three_way(a.u.i, b.u.i);
+}
+
+// double和整数n比较：先比较整数部分，相同时再看小数部分的符号
+int Comparator::compare_double(double d, const Json& n) {
+    if (d != d)
+        return 1;
+    if (d >= 2 * two63)
+        return 1;
+    if (d < -two63)
+        return -1;
+    if (d >= two63) {
+        // 这个范围内的double都是整数
+        if (n.tag == Json::TAG_INT)
+            return 1;
+        return three_way(static_cast<uint64_t>(d), n.u.ui);
+    }
+    if (n.tag == Json::TAG_UINT)
+        return -1;
+    int64_t t = static_cast<int64_t>(d);
+    if (t != n.u.i)
+        return t < n.u.i ? -1 : 1;
+    return three_way(d - static_cast<double>(t), 0.0);
+}
+
+int Comparator::compare_numbers(const Json& a, const Json& b) {
+    bool da = a.tag == Json::TAG_DOUBLE, db = b.tag == Json::TAG_DOUBLE;
+    if (!da && !db)
+        return compare_integers(a, b);
+    if (da && db) {
+        bool na = a.u.d != a.u.d, nb = b.u.d != b.u.d;
+        return na || nb ? na - nb : three_way(a.u.d, b.u.d);
+    }
+    return da ? compare_double(a.u.d, b) : -compare_double(b.u.d, a);
+}
+
+// 相等的数字得到相同的hash：整数值的double按照整数计算
+uint64_t Comparator::hash_number(const Json& j) {
+    if (j.tag != Json::TAG_DOUBLE)
+        return mix(j.u.ui);
+    double d = j.u.d;
+    if (d != d)
+        return mix(0x7FF8000000000000ULL);
+    if (d >= -two63 && d < two63 && d == static_cast<double>(static_cast<int64_t>(d)))
+        return mix(static_cast<uint64_t>(static_cast<int64_t>(d)));
+    if (d >= two63 && d < 2 * two63)
+        return mix(static_cast<uint64_t>(d));
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return mix(bits);
+}
+
+bool Comparator::equal(const Json& a, const Json& b) {
+    Json::Type t = a.type();
+    if (t != b.type())
+        return false;
+    switch (t) {
+        case Json::JSON_NULL: return true;
+        case Json::JSON_BOOL: return a.u.b == b.u.b;
+        case Json::JSON_NUMBER: return compare_numbers(a, b) == 0;
+        default: break;
+    }
+    if (a.u.p == b.u.p)
+        return true;
+    if (known_different(a, b))
+        return false;
+    if (t == Json::JSON_STRING)
+        return a.string_view() == b.string_view();
+    if (t == Json::JSON_ARRAY) {
+        const Json::array& x = a.array_value();
+        const Json::array& y = b.array_value();
+        if (x.size() != y.size())
+            return false;
+        for (size_t k = 0; k < x.size(); k++)
+            if (!equal(x[k], y[k]))
+                return false;
+        return true;
+    }
+    const Json::object& x = a.object_value();
+    const Json::object& y = b.object_value();
+    if (x.size() != y.size())
+        return false;
+    for (auto& kv : x) {
+        auto it = y.find(kv.first);
+        if (it == y.end() || !equal(kv.second, it->second))
+            return false;
+    }
+    return true;
+}
+
+// 对象的成员按照key排序后逐个比较key和值，和成员原来的顺序无关
+int Comparator::compare_objects(const Json::object& x, const Json::object& y) {
+    typedef const Json::object::value_type* Member;
+    auto sorted = [](const Json::object& o) {
+        std::vector<Member> v;
+        v.reserve(o.size());
+        for (auto& kv : o)
+            v.push_back(&kv);
+        std::stable_sort(v.begin(), v.end(), [](Member p, Member q) {
+            return StringView(p->first.data(), p->first.size()) < StringView(q->first.data(), q->first.size());
+        });
+        return v;
+    };
+    std::vector<Member> sx = sorted(x), sy = sorted(y);
+    for (size_t k = 0; k < sx.size() && k < sy.size(); k++) {
+        StringView kx(sx[k]->first.data(), sx[k]->first.size()), ky(sy[k]->first.data(), sy[k]->first.size());
+        if (kx != ky)
+            return kx < ky ? -1 : 1;
+        if (int r = compare(sx[k]->second, sy[k]->second))
+            return r;
+    }
+    return three_way(sx.size(), sy.size());
+}
+
+int Comparator::compare(const Json& a, const Json& b) {
+    Json::Type t = a.type();
+    if (t != b.type())
+        return t < b.type() ? -1 : 1;
+    switch (t) {
+        case Json::JSON_NULL: return 0;
+        case Json::JSON_BOOL: return three_way(a.u.b, b.u.b);
+        case Json::JSON_NUMBER: return compare_numbers(a, b);
+        default: break;
+    }
+    if (a.u.p == b.u.p)
+        return 0;
+    if (t == Json::JSON_STRING)
+        return three_way(a.string_view(), b.string_view());
+    if (t == Json::JSON_ARRAY) {
+        const Json::array& x = a.array_value();
+        const Json::array& y = b.array_value();
+        for (size_t k = 0; k < x.size() && k < y.size(); k++)
+            if (int r = compare(x[k], y[k]))
+                return r;
+        return three_way(x.size(), y.size());
+    }
+    return compare_objects(a.object_value(), b.object_value());
+}
+
+// 数组的hash依赖元素的顺序，对象的hash是各个成员hash的和，和顺序无关
+uint64_t Comparator::compute_hash(const Json& j) {
+    if (j.type() == Json::JSON_STRING) {
+        StringView s = j.string_view();
+        return Key::hash(s.data(), s.size());
+    }
+    if (j.tag == Json::TAG_ARRAY) {
+        uint64_t h = 0x9E3779B97F4A7C15ULL;
+        for (const Json& e : j.array_value())
+            h = mix(h + hash(e));
+        return h;
+    }
+    uint64_t h = 0;
+    for (auto& kv : j.object_value())
+        h += mix(kv.first.hash() + mix(hash(kv.second)));
+    return mix(h + j.object_value().size());
+}
+
+uint64_t Comparator::hash(const Json& j) {
+    Json::Type t = j.type();
+    switch (t) {
+        case Json::JSON_NULL: return mix(1);
+        case Json::JSON_BOOL: return mix(j.u.b ? 3 : 2);
+        case Json::JSON_NUMBER: return hash_number(j);
+        default: break;
+    }
+    std::atomic<uint64_t>& cached = j.u.p->hash_code;
+    uint64_t h = cached.load(std::memory_order_relaxed);
+    if (h)
+        return h;
+    // 类型也参与hash，使得""、[]、{}各不相同
+    h = mix(compute_hash(j) + t);
+    if (!h)
+        h = 1;
+    cached.store(h, std::memory_order_relaxed);
+    return h;
+}
+
+uint64_t Json::hash() const {
+    return Comparator::hash(*this);
+}
+
+bool Json::operator==(const Json& rhs) const {
+    return Comparator::equal(*this, rhs);
+}
+
+bool Json::operator<(const Json& rhs) const {
+    return Comparator::compare(*this, rhs) < 0;
+}
+
+}  // namespace myjson
@@ -0,0 +1,332 @@
+#include "dtoa.h"
+#include <cmath>
+#include <cstring>
+
+namespace myjson {
+
+/*
+    Grisu2算法，参考Florian Loitsch, Printing Floating-Point Numbers Quickly and Accurately with Integers，
+    实现方式与miloyip/dtoa-benchmark中的milo版本相同。
+*/
+
+// 两位数字的查找表，一次输出两个字符
+static const char kDigitsLut[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+// 10^k的64位规范化近似值，k = -348 + 8 * i
+static const uint64_t kCachedPowersF[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t kCachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const int kDiySignificandSize = 64;
+static const int kDpSignificandSize = 52;
+static const int kDpExponentBias = 0x3FF + kDpSignificandSize;
+static const int kDpMinExponent = -kDpExponentBias;
+static const uint64_t kDpExponentMask = 0x7FF0000000000000ULL;
+static const uint64_t kDpSignificandMask = 0x000FFFFFFFFFFFFFULL;
+static const uint64_t kDpHiddenBit = 0x0010000000000000ULL;
+
+// 自定义的浮点数 f * 2^e
+struct DiyFp {
+    uint64_t f;
+    int e;
+
+    DiyFp() : f(0), e(0) {}
+    DiyFp(uint64_t f, int e) : f(f), e(e) {}
+
+    explicit DiyFp(double d) {
+        uint64_t u;
+        std::memcpy(&u, &d, sizeof(d));
+        int biased_e = static_cast<int>((u & kDpExponentMask) >> kDpSignificandSize);
+        uint64_t significand = u & kDpSignificandMask;
+        if (biased_e != 0) {
+            f = significand + kDpHiddenBit;
+            e = biased_e - kDpExponentBias;
+        } else {
+            f = significand;
+            e = kDpMinExponent + 1;
+        }
+    }
+
+    DiyFp operator-(const DiyFp& rhs) const { return DiyFp(f - rhs.f, e); }
+
+    // 128位乘积取高64位，并对低位四舍五入
+    DiyFp operator*(const DiyFp& rhs) const {
+#ifdef __SIZEOF_INT128__
+        unsigned __int128 p = static_cast<unsigned __int128>(f) * rhs.f;
+        uint64_t h = static_cast<uint64_t>(p >> 64);
+        uint64_t l = static_cast<uint64_t>(p);
+        if (l & (uint64_t(1) << 63))
+            h++;
+        return DiyFp(h, e + rhs.e + 64);
+#else
+        const uint64_t M32 = 0xFFFFFFFF;
+        const uint64_t a = f >> 32, b = f & M32, c = rhs.f >> 32, d = rhs.f & M32;
+        const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+        uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+        tmp += 1U << 31;
+        return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+#endif
+    }
+
+    DiyFp normalize() const {
+        int s = __builtin_clzll(f);
+        return DiyFp(f << s, e - s);
+    }
+
+    DiyFp normalize_boundary() const {
+        DiyFp res = *this;
+        while (!(res.f & (kDpHiddenBit << 1))) {
+            res.f <<= 1;
+            res.e--;
+        }
+        res.f <<= (kDiySignificandSize - kDpSignificandSize - 2);
+        res.e = res.e - (kDiySignificandSize - kDpSignificandSize - 2);
+        return res;
+    }
+
+    // 与相邻double的中点作为上下边界
+    void normalized_boundaries(DiyFp* minus, DiyFp* plus) const {
+        DiyFp pl = DiyFp((f << 1) + 1, e - 1).normalize_boundary();
+        DiyFp mi = (f == kDpHiddenBit) ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+        mi.f <<= mi.e - pl.e;
+        mi.e = pl.e;
+        *plus = pl;
+        *minus = mi;
+    }
+};
+
+static DiyFp get_cached_power(int e, int* K) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347;  // dk必须为正数，才能用强制转换取整
+    int k = static_cast<int>(dk);
+    if (dk - k > 0.0)
+        k++;
+    unsigned index = static_cast<unsigned>((k >> 3) + 1);
+    *K = -(-348 + static_cast<int>(index << 3));
+    return DiyFp(kCachedPowersF[index], kCachedPowersE[index]);
+}
+
+static void grisu_round(char* buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static unsigned count_decimal_digit32(uint32_t n) {
+    if (n < 10) return 1;
+    if (n < 100) return 2;
+    if (n < 1000) return 3;
+    if (n < 10000) return 4;
+    if (n < 100000) return 5;
+    if (n < 1000000) return 6;
+    if (n < 10000000) return 7;
+    if (n < 100000000) return 8;
+    return 9;
+}
+
+static void digit_gen(const DiyFp& W, const DiyFp& Mp, uint64_t delta, char* buffer, int* len, int* K) {
+    static const uint32_t kPow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+    const DiyFp one(uint64_t(1) << -Mp.e, Mp.e);
+    const DiyFp wp_w = Mp - W;
+    uint32_t p1 = static_cast<uint32_t>(Mp.f >> -one.e);
+    uint64_t p2 = Mp.f & (one.f - 1);
+    unsigned kappa = count_decimal_digit32(p1);
+    *len = 0;
+
+    while (kappa > 0) {
+        uint32_t d = p1 / kPow10[kappa - 1];
+        p1 %= kPow10[kappa - 1];
+        if (d || *len)
+            buffer[(*len)++] = static_cast<char>('0' + d);
+        kappa--;
+        uint64_t tmp = (static_cast<uint64_t>(p1) << -one.e) + p2;
+        if (tmp <= delta) {
+            *K += kappa;
+            grisu_round(buffer, *len, delta, tmp, static_cast<uint64_t>(kPow10[kappa]) << -one.e, wp_w.f);
+            return;
+        }
+    }
+
+    // kappa = 0，继续输出小数部分
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = static_cast<char>(p2 >> -one.e);
+        if (d || *len)
+            buffer[(*len)++] = static_cast<char>('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            int index = -static_cast<int>(kappa);
+            grisu_round(buffer, *len, delta, p2, one.f, wp_w.f * (index < 9 ? kPow10[index] : 0));
+            return;
+        }
+    }
+}
+
+static void grisu2(double value, char* buffer, int* length, int* K) {
+    const DiyFp v(value);
+    DiyFp w_m, w_p;
+    v.normalized_boundaries(&w_m, &w_p);
+
+    const DiyFp c_mk = get_cached_power(w_p.e, K);
+    const DiyFp W = v.normalize() * c_mk;
+    DiyFp Wp = w_p * c_mk;
+    DiyFp Wm = w_m * c_mk;
+    Wm.f++;
+    Wp.f--;
+    digit_gen(W, Wp, Wp.f - Wm.f, buffer, length, K);
+}
+
+static char* write_exponent(int K, char* buffer) {
+    if (K < 0) {
+        *buffer++ = '-';
+        K = -K;
+    }
+    if (K >= 100) {
+        *buffer++ = static_cast<char>('0' + K / 100);
+        K %= 100;
+        *buffer++ = kDigitsLut[K * 2];
+        *buffer++ = kDigitsLut[K * 2 + 1];
+    } else if (K >= 10) {
+        *buffer++ = kDigitsLut[K * 2];
+        *buffer++ = kDigitsLut[K * 2 + 1];
+    } else {
+        *buffer++ = static_cast<char>('0' + K);
+    }
+    return buffer;
+}
+
+// 根据数字位数和指数选择普通小数或者科学计数法
+static char* prettify(char* buffer, int length, int k) {
+    const int kk = length + k;  // 10^(kk-1) <= v < 10^kk
+
+    if (0 <= k && kk <= 21) {
+        // 1234e7 -> 12340000000.0
+        for (int i = length; i < kk; i++)
+            buffer[i] = '0';
+        buffer[kk] = '.';
+        buffer[kk + 1] = '0';
+        return &buffer[kk + 2];
+    } else if (0 < kk && kk <= 21) {
+        // 1234e-2 -> 12.34
+        std::memmove(&buffer[kk + 1], &buffer[kk], static_cast<size_t>(length - kk));
+        buffer[kk] = '.';
+        return &buffer[length + 1];
+    } else if (-6 < kk && kk <= 0) {
+        // 1234e-6 -> 0.001234
+        const int offset = 2 - kk;
+        std::memmove(&buffer[offset], &buffer[0], static_cast<size_t>(length));
+        buffer[0] = '0';
+        buffer[1] = '.';
+        for (int i = 2; i < offset; i++)
+            buffer[i] = '0';
+        return &buffer[length + offset];
+    } else if (length == 1) {
+        // 1e30
+        buffer[1] = 'e';
+        return write_exponent(kk - 1, &buffer[2]);
+    } else {
+        // 1234e30 -> 1.234e33
+        std::memmove(&buffer[2], &buffer[1], static_cast<size_t>(length - 1));
+        buffer[1] = '.';
+        buffer[length + 1] = 'e';
+        return write_exponent(kk - 1, &buffer[length + 2]);
+    }
+}
+
+char* dtoa(double value, char* buffer) {
+    if (value == 0) {
+        if (std::signbit(value))
+            *buffer++ = '-';
+        std::memcpy(buffer, "0.0", 3);
+        return buffer + 3;
+    }
+    if (value < 0) {
+        *buffer++ = '-';
+        value = -value;
+    }
+    int length, K;
+    grisu2(value, buffer, &length, &K);
+    return prettify(buffer, length, K);
+}
+
+// 从低位开始每次输出两位数字，再整体翻转
+char* u64toa(uint64_t value, char* buffer) {
+    char tmp[20];
+    char* p = tmp;
+    while (value >= 100) {
+        unsigned i = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        *p++ = kDigitsLut[i + 1];
+        *p++ = kDigitsLut[i];
+    }
+    if (value < 10) {
+        *p++ = static_cast<char>('0' + value);
+    } else {
+        unsigned i = static_cast<unsigned>(value) * 2;
+        *p++ = kDigitsLut[i + 1];
+        *p++ = kDigitsLut[i];
+    }
+    do {
+        *buffer++ = *--p;
+    } while (p != tmp);
+    return buffer;
+}
+
+char* i64toa(int64_t value, char* buffer) {
+    uint64_t u = static_cast<uint64_t>(value);
+    if (value < 0) {
+        *buffer++ = '-';
+        u = ~u + 1;
+    }
+    return u64toa(u, buffer);
+}
+
+}  // namespace myjson
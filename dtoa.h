@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+namespace myjson {
+
+/*
+    数字转字符串，结果写入buffer，返回写入的末尾位置（不写'\0'）。
+    dtoa使用Grisu2算法输出能够精确还原的最短表示，buffer至少需要32字节；
+    整数版本至少需要21字节。
+*/
+char* dtoa(double value, char* buffer);
+char* i64toa(int64_t value, char* buffer);
+char* u64toa(uint64_t value, char* buffer);
+
+}  // namespace myjson
@@ -0,0 +1,153 @@
+#include "myjson.h"
+#include "dump.h"
+#include "simd.h"
+#include <algorithm>
+
+namespace myjson {
+
+/*
+    转义表：0表示不需要转义，'u'表示输出为\u00XX，其余为反斜杠后面的字符
+*/
+static const char kEscape[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+static const char kHexDigits[] = "0123456789ABCDEF";
+
+// 需要转义的字符和解析时需要特殊处理的字符是同一组，可以直接用SIMD扫描
+void dump_string(const char* s, size_t n, string& out) {
+    const char* end = s + n;
+    out += '"';
+    while (true) {
+        const char* p = simd::scan_string(s, end);
+        out.append(s, p);
+        if (p == end)
+            break;
+        unsigned char ch = static_cast<unsigned char>(*p);
+        char esc = kEscape[ch];
+        if (esc == 'u') {
+            char buf[6] = {'\\', 'u', '0', '0', kHexDigits[ch >> 4], kHexDigits[ch & 0xF]};
+            out.append(buf, 6);
+        } else {
+            char buf[2] = {'\\', esc};
+            out.append(buf, 2);
+        }
+        s = p + 1;
+    }
+    out += '"';
+}
+
+/*
+    Serializer：递归地把Json写入同一个string
+*/
+class Serializer {
+public:
+    Serializer(string& out, int indent, bool sort_keys) : out(out), indent(indent), sort_keys(sort_keys) {}
+    void write(const Json& json, int depth);
+
+private:
+    void newline(int depth) {
+        if (indent > 0) {
+            out += '\n';
+            out.append(static_cast<size_t>(depth) * indent, ' ');
+        }
+    }
+
+    string& out;
+    int indent;
+    bool sort_keys;
+    // 排序后的成员，嵌套的对象共用
+    std::vector<const Json::object::value_type*> order;
+};
+
+void Serializer::write(const Json& json, int depth) {
+    switch (json.tag) {
+        case Json::TAG_NULL:
+            out.append("null", 4);
+            break;
+        case Json::TAG_BOOL:
+            if (json.u.b) out.append("true", 4);
+            else out.append("false", 5);
+            break;
+        case Json::TAG_INT:
+            dump_number(json.u.i, out);
+            break;
+        case Json::TAG_UINT:
+            dump_number(json.u.ui, out);
+            break;
+        case Json::TAG_DOUBLE:
+            dump_number(json.u.d, out);
+            break;
+        case Json::TAG_STRING:
+        case Json::TAG_STRING_VIEW: {
+            StringView s = json.string_view();
+            dump_string(s.data(), s.size(), out);
+            break;
+        }
+        case Json::TAG_ARRAY: {
+            const Json::array& a = json.array_value();
+            out += '[';
+            if (!a.empty()) {
+                bool first = true;
+                for (auto& e : a) {
+                    if (!first) out += ',';
+                    first = false;
+                    newline(depth + 1);
+                    write(e, depth + 1);
+                }
+                newline(depth);
+            }
+            out += ']';
+            break;
+        }
+        case Json::TAG_OBJECT: {
+            const Json::object& o = json.object_value();
+            out += '{';
+            if (!o.empty()) {
+                size_t base = order.size();
+                for (auto& kv : o)
+                    order.push_back(&kv);
+                // 相同的key保持原来的顺序
+                if (sort_keys)
+                    std::stable_sort(order.begin() + base, order.end(),
+                                     [](const Json::object::value_type* a, const Json::object::value_type* b) {
+                                         return a->first < b->first;
+                                     });
+                for (size_t k = base; k < base + o.size(); k++) {
+                    const Json::object::value_type& kv = *order[k];
+                    if (k != base) out += ',';
+                    newline(depth + 1);
+                    dump_string(kv.first.data(), kv.first.size(), out);
+                    out += ':';
+                    if (indent > 0) out += ' ';
+                    write(kv.second, depth + 1);
+                }
+                order.resize(base);
+                newline(depth);
+            }
+            out += '}';
+            break;
+        }
+    }
+}
+
+void dump_value(const Json& json, string& out, int indent, bool sort_keys, int depth) {
+    Serializer(out, indent, sort_keys).write(json, depth);
+}
+
+void Json::dump(string& out, int indent, bool sort_keys) const {
+    Serializer(out, indent, sort_keys).write(*this, 0);
+}
+
+string Json::dump(int indent, bool sort_keys) const {
+    string out;
+    dump(out, indent, sort_keys);
+    return out;
+}
+
+}  // namespace myjson
@@ -0,0 +1,35 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "dtoa.h"
+
+namespace myjson {
+
+class Json;
+
+// 把s转义后加上引号追加到out。只转义'"'、'\\'和控制字符，其余UTF-8字节原样输出
+void dump_string(const char* s, size_t n, std::string& out);
+
+// 数字追加到out，Json::dump和Writer使用同样的格式。JSON中没有NaN和无穷大，输出为null
+inline void dump_number(int64_t value, std::string& out) {
+    char buf[32];
+    out.append(buf, i64toa(value, buf));
+}
+inline void dump_number(uint64_t value, std::string& out) {
+    char buf[32];
+    out.append(buf, u64toa(value, buf));
+}
+inline void dump_number(double value, std::string& out) {
+    char buf[32];
+    if (std::isfinite(value))
+        out.append(buf, dtoa(value, buf));
+    else
+        out.append("null", 4);
+}
+
+// 把json追加到out，depth是json所在的层数，indent大于0时用来计算缩进
+void dump_value(const Json& json, std::string& out, int indent, bool sort_keys, int depth);
+
+}  // namespace myjson
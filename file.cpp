@@ -0,0 +1,106 @@
+#include "file.h"
+#include "simd.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace myjson {
+
+/*
+    MappedFile
+*/
+State MappedFile::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return JSON_PARSE_IO_ERROR;
+    struct stat st;
+    size_t size = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ? st.st_size : 0;
+    if (size > 0) {
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, size, MADV_SEQUENTIAL);
+            madvise(p, size, MADV_WILLNEED);
+            ::close(fd);
+            map = p;
+            ptr = static_cast<const char*>(p);
+            len = size;
+            return JSON_PARSE_OK;
+        }
+    }
+    // 不能映射时读进内存，大小未知时每次把缓冲区扩大一倍
+    size_t n = 0;
+    fallback.resize(size > 0 ? size : 64 * 1024);
+    while (true) {
+        if (n == fallback.size())
+            fallback.resize(n * 2);
+        ssize_t r = ::read(fd, &fallback[n], fallback.size() - n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0) {
+            ::close(fd);
+            fallback.clear();
+            return JSON_PARSE_IO_ERROR;
+        }
+        if (r == 0)
+            break;
+        n += r;
+    }
+    ::close(fd);
+    fallback.resize(n);
+    ptr = fallback.data();
+    len = n;
+    return JSON_PARSE_OK;
+}
+
+void MappedFile::close() {
+    if (map)
+        munmap(map, len);
+    map = nullptr;
+    ptr = "";
+    len = 0;
+    string().swap(fallback);
+}
+
+Json Json::parse_file(const string& path) {
+    MappedFile file;
+    if (file.open(path) != JSON_PARSE_OK)
+        return Json(JSON_PARSE_IO_ERROR);
+    return Json::parse(file.data(), file.size());
+}
+
+/*
+    NdjsonReader
+*/
+NdjsonReader::NdjsonReader(const string& path) {
+    error = file.open(path);
+    cur = file.data();
+    end = cur + file.size();
+}
+
+bool NdjsonReader::next_line(StringView& line) {
+    while (cur != end) {
+        const char* nl = static_cast<const char*>(std::memchr(cur, '\n', end - cur));
+        const char* stop = nl ? nl : end;
+        const char* begin = cur;
+        cur = nl ? nl + 1 : end;
+        line_no = next_no++;
+        if (simd::skip_whitespace(begin, stop) != stop) {
+            line = StringView(begin, stop - begin);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool NdjsonReader::next(Json& record) {
+    StringView line;
+    if (!next_line(line))
+        return false;
+    record = Json::parse(line.data(), line.size());
+    return true;
+}
+
+}  // namespace myjson
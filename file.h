@@ -0,0 +1,63 @@
+#pragma once
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    只读地映射整个文件。mmap失败（比如管道、某些特殊文件系统）时退回到用read()读进内存，
+    对使用者来说没有区别。映射后用madvise提示内核按顺序读取，尽早预读后面的页。
+*/
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // 成功时返回JSON_PARSE_OK，否则返回JSON_PARSE_IO_ERROR
+    State open(const string& path);
+    void close();
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool mapped() const { return map != nullptr; }
+
+private:
+    const char* ptr = "";
+    size_t len = 0;
+    void* map = nullptr;
+    string fallback;
+};
+
+/*
+    NDJSON（JSON Lines）：每一行是一个独立的JSON值。
+    NdjsonReader按行切分输入，每一行直接在原来的内存（通常是MappedFile）上解析，不复制行的内容。
+    只有空白的行会被跳过；某一行解析失败时返回的Json带有错误码，可以继续读下一行。
+*/
+class NdjsonReader {
+public:
+    NdjsonReader(const char* data, size_t len) : cur(data), end(data + len) {}
+    // 读取文件，文件无法打开时state()为JSON_PARSE_IO_ERROR，next()直接返回false
+    explicit NdjsonReader(const string& path);
+
+    // 下一条记录，没有更多记录时返回false
+    bool next(Json& record);
+    // 下一个非空行（不含换行符），可以交给Document::parse()等自己解析
+    bool next_line(StringView& line);
+
+    // 最近一次返回的行号，从1开始
+    size_t line_number() const { return line_no; }
+    State state() const { return error; }
+
+private:
+    MappedFile file;
+    const char* cur = nullptr;
+    const char* end = nullptr;
+    size_t line_no = 0;
+    size_t next_no = 1;
+    State error = JSON_PARSE_OK;
+};
+
+}  // namespace myjson
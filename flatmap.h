@@ -0,0 +1,188 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include "arena.h"
+#include "key.h"
+
+namespace myjson {
+
+/*
+    FlatMap：Json::object的存储。成员按插入的顺序连续存放在一个vector中，遍历时没有指针跳转。
+    成员较少时查找直接从后往前比较key；超过index_threshold个成员后另外建立一个开放寻址的哈希索引，
+    索引中只保存成员的下标，哈希值直接取自Key。
+    允许保存重复的key，查找时得到最后一个。分配器和Json::array一样，可以从Arena中取内存。
+*/
+template <typename V>
+class FlatMap {
+public:
+    typedef Key key_type;
+    typedef V mapped_type;
+    typedef std::pair<Key, V> value_type;
+    typedef JsonAllocator<value_type> allocator_type;
+    typedef std::vector<value_type, allocator_type> storage;
+    typedef typename storage::iterator iterator;
+    typedef typename storage::const_iterator const_iterator;
+    typedef size_t size_type;
+
+    static const size_t index_threshold = 16;
+
+    FlatMap() = default;
+    explicit FlatMap(const allocator_type& alloc) : items(alloc), slots(alloc) {}
+    FlatMap(std::initializer_list<value_type> init) {
+        for (auto& kv : init)
+            (*this)[kv.first] = kv.second;
+    }
+
+    iterator begin() { return items.begin(); }
+    iterator end() { return items.end(); }
+    const_iterator begin() const { return items.begin(); }
+    const_iterator end() const { return items.end(); }
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    void reserve(size_t n) { items.reserve(n); }
+    // 成员数组和索引实际占用的内存块个数和字节数，用于统计
+    size_t allocations() const { return (items.capacity() != 0) + (slots.capacity() != 0); }
+    size_t allocated_bytes() const { return items.capacity() * sizeof(value_type) + slots.capacity() * sizeof(uint32_t); }
+    void clear() {
+        items.clear();
+        slots.clear();
+    }
+
+    // 用同一个InternPool中的Key查找时，相同的key只需要比较指针
+    iterator find(const Key& key) { return items.begin() + locate(key); }
+    const_iterator find(const Key& key) const { return items.begin() + locate(key); }
+    template <typename K>
+    iterator find(const K& key) { return items.begin() + locate(key.data(), key.size()); }
+    template <typename K>
+    const_iterator find(const K& key) const { return items.begin() + locate(key.data(), key.size()); }
+    iterator find(const char* key) { return items.begin() + locate(key, std::strlen(key)); }
+    const_iterator find(const char* key) const { return items.begin() + locate(key, std::strlen(key)); }
+    template <typename K>
+    size_t count(const K& key) const { return find(key) != end() ? 1 : 0; }
+
+    // 和std::map一样，key不存在时插入一个默认值
+    V& operator[](Key key) {
+        size_t k = locate(key);
+        if (k == items.size())
+            push_back(value_type(std::move(key), V()));
+        return items[k].second;
+    }
+
+    // 和std::map一样，key已经存在时不插入
+    std::pair<iterator, bool> insert(value_type kv) {
+        size_t k = locate(kv.first);
+        if (k != items.size())
+            return std::make_pair(items.begin() + k, false);
+        push_back(std::move(kv));
+        return std::make_pair(items.end() - 1, true);
+    }
+
+    // key已经存在时替换它的值（位置不变），否则插入到最后
+    void assign(value_type kv) {
+        size_t k = locate(kv.first);
+        if (k != items.size())
+            items[k].second = std::move(kv.second);
+        else
+            push_back(std::move(kv));
+    }
+
+    // 总是插入到最后，允许重复的key
+    void push_back(value_type kv) {
+        items.push_back(std::move(kv));
+        if (!slots.empty() && items.size() * 2 <= slots.size())
+            insert_slot(items.size() - 1);
+        else if (items.size() > index_threshold)
+            rebuild();
+    }
+
+    // 删除所有等于key的成员，返回删除的个数
+    template <typename K>
+    size_t erase(const K& key) {
+        size_t n = items.size();
+        size_t w = 0;
+        uint64_t h = Key::hash(key.data(), key.size());
+        for (size_t r = 0; r < n; r++) {
+            if (!items[r].first.equals(key.data(), key.size(), h)) {
+                if (w != r)
+                    items[w] = std::move(items[r]);
+                w++;
+            }
+        }
+        items.erase(items.begin() + w, items.end());
+        if (w != n)
+            rebuild();
+        return n - w;
+    }
+    iterator erase(const_iterator pos) {
+        size_t k = pos - items.cbegin();
+        items.erase(items.begin() + k);
+        rebuild();
+        return items.begin() + k;
+    }
+
+private:
+    typedef std::vector<uint32_t, JsonAllocator<uint32_t>> index;
+
+    // 返回key最后一次出现的下标，不存在时返回size()
+    size_t locate(const Key& key) const {
+        if (slots.empty()) {
+            for (size_t k = items.size(); k-- > 0;)
+                if (items[k].first == key)
+                    return k;
+            return items.size();
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t h = key.hash() & mask; slots[h]; h = (h + 1) & mask)
+            if (items[slots[h] - 1].first == key)
+                return slots[h] - 1;
+        return items.size();
+    }
+
+    size_t locate(const char* s, size_t n) const {
+        if (n <= Key::max_inline)
+            return locate(Key(s, n));
+        uint64_t hash = Key::hash(s, n);
+        if (slots.empty()) {
+            for (size_t k = items.size(); k-- > 0;)
+                if (items[k].first.equals(s, n, hash))
+                    return k;
+            return items.size();
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t h = hash & mask; slots[h]; h = (h + 1) & mask)
+            if (items[slots[h] - 1].first.equals(s, n, hash))
+                return slots[h] - 1;
+        return items.size();
+    }
+
+    // 槽中保存下标+1，0表示空。同一个key在槽中只保留最后一个成员
+    void insert_slot(size_t k) {
+        const Key& key = items[k].first;
+        size_t mask = slots.size() - 1;
+        size_t h = key.hash() & mask;
+        for (; slots[h]; h = (h + 1) & mask)
+            if (items[slots[h] - 1].first == key)
+                break;
+        slots[h] = static_cast<uint32_t>(k + 1);
+    }
+
+    // 负载不超过1/2
+    void rebuild() {
+        slots.clear();
+        if (items.size() <= index_threshold)
+            return;
+        size_t cap = 64;
+        while (cap < items.size() * 4)
+            cap *= 2;
+        slots.assign(cap, 0);
+        for (size_t k = 0; k < items.size(); k++)
+            insert_slot(k);
+    }
+
+    storage items;
+    index slots;
+};
+
+}  // namespace myjson
@@ -0,0 +1,179 @@
+#include "index.h"
+#include "simd.h"
+#include <atomic>
+#include <thread>
+
+namespace myjson {
+
+/*
+    被转义的字符：连续的反斜杠中，从序列开头数第偶数个（从0开始）之后的字符是被转义的。
+    分别处理从奇数位和偶数位开始的序列，用加法的进位一次找出所有序列的结尾。
+    prev_escaped记录上一块的最后一个反斜杠是否转义了这一块的第一个字符。
+*/
+static inline uint64_t find_escaped(uint64_t backslash, uint64_t& prev_escaped) {
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    backslash &= ~prev_escaped;
+    uint64_t follows_escape = backslash << 1 | prev_escaped;
+    uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t sequences_starting_on_even_bits;
+    prev_escaped = __builtin_add_overflow(odd_sequence_starts, backslash, &sequences_starting_on_even_bits);
+    uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+// 第k位是第0到k位的异或，也就是从开引号（含）到闭引号（不含）之间的位为1
+static inline uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+bool StructuralIndex::build(const char* data, size_t len) {
+    size_t nblocks = (len + 63) / 64;
+    bits.assign(nblocks, 0);
+    uint64_t prev_escaped = 0;
+    uint64_t prev_in_string = 0;
+    char tail[64];
+    for (size_t b = 0; b < nblocks; b++) {
+        const char* p = data + b * 64;
+        size_t left = len - b * 64;
+        if (left < 64) {
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, p, left);
+            p = tail;
+        }
+        simd::Masks m;
+        simd::classify(p, m);
+        uint64_t quote = m.quote & ~find_escaped(m.backslash, prev_escaped);
+        uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+        bits[b] = m.op & ~in_string;
+    }
+    return prev_in_string == 0;
+}
+
+/*
+    第二阶段：根是数组或者对象时，用索引找出深度为1的逗号，把根的元素分给多个线程，
+    每个线程用自己的JsonParser解析分到的元素，最后按顺序组装。
+    索引只检查括号的配对，元素内部的语法仍由JsonParser检查。
+    任何地方出错时都回到单线程的Json::parse()，保证错误码和串行解析完全一样。
+*/
+static const size_t parallel_threshold = 1 << 20;
+static const size_t batch_size = 64;
+
+// 找出根的开括号、深度为1的逗号和根的闭括号的位置，结构不符合要求时返回false
+static bool split_root(const char* in, size_t len, const StructuralIndex& index, std::vector<size_t>& seps) {
+    const char* first = simd::skip_whitespace(in, in + len);
+    if (first == in + len || (*first != '[' && *first != '{'))
+        return false;
+    std::vector<char> stack;
+    size_t root_end = 0;
+    bool ok = true;
+    index.for_each([&](size_t pos) {
+        char ch = in[pos];
+        if (stack.empty() && !seps.empty()) {
+            ok = false;  // 根之后还有结构字符
+        } else if (ch == '[' || ch == '{') {
+            if (stack.empty())
+                ok = in + pos == first;
+            stack.push_back(ch == '[' ? ']' : '}');
+            if (stack.size() == 1)
+                seps.push_back(pos);
+        } else if (ch == ']' || ch == '}') {
+            ok = !stack.empty() && stack.back() == ch;
+            if (ok) {
+                stack.pop_back();
+                if (stack.empty()) {
+                    seps.push_back(pos);
+                    root_end = pos + 1;
+                }
+            }
+        } else if (ch == ',' && stack.size() == 1) {
+            seps.push_back(pos);
+        } else if (stack.empty()) {
+            ok = false;
+        }
+        return ok;
+    });
+    return ok && stack.empty() && root_end != 0 && simd::skip_whitespace(in + root_end, in + len) == in + len;
+}
+
+Json Json::parse_parallel(const char* in, size_t len, unsigned threads) {
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads <= 1 || len < parallel_threshold)
+        return parse(in, len);
+
+    StructuralIndex index;
+    std::vector<size_t> seps;
+    if (!index.build(in, len) || !split_root(in, len, index, seps))
+        return parse(in, len);
+
+    bool is_object = in[seps.front()] == '{';
+    size_t n = seps.size() - 1;
+    // 只有一个元素并且全是空白，是空的数组或对象
+    if (n == 1 && simd::skip_whitespace(in + seps[0] + 1, in + seps[1]) == in + seps[1])
+        n = 0;
+
+    std::vector<Json> values(n);
+    std::vector<string> keys(is_object ? n : 0);
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    auto worker = [&]() {
+        JsonParser parser(nullptr, 0);
+        // 根已经占了一层
+        parser.limit_depth(default_max_depth - 1);
+        while (!failed.load(std::memory_order_relaxed)) {
+            size_t begin = next.fetch_add(batch_size);
+            if (begin >= n)
+                return;
+            size_t end = begin + batch_size < n ? begin + batch_size : n;
+            for (size_t k = begin; k < end; k++) {
+                parser.reset(in + seps[k] + 1, seps[k + 1] - seps[k] - 1);
+                if (is_object) {
+                    if (parser.get_next_token() != '"') {
+                        failed = true;
+                        return;
+                    }
+                    keys[k] = parser.parse_string();
+                    if (parser.failed || parser.get_next_token() != ':') {
+                        failed = true;
+                        return;
+                    }
+                }
+                values[k] = parser.parse();
+                if (values[k].state != JSON_PARSE_OK) {
+                    failed = true;
+                    return;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+    if (failed)
+        return parse(in, len);
+
+    if (is_object) {
+        Json::object members;
+        for (size_t k = 0; k < n; k++)
+            members[std::move(keys[k])] = std::move(values[k]);
+        return Json(std::move(members));
+    }
+    Json::array elements;
+    elements.reserve(n);
+    for (size_t k = 0; k < n; k++)
+        elements.push_back(std::move(values[k]));
+    return Json(std::move(elements));
+}
+
+}  // namespace myjson
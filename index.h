@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    结构索引（两阶段解析的第一阶段）：找出所有不在字符串中的结构字符'{' '}' '[' ']' ':' ','。
+    输入按64字节分块，每块用SIMD得到引号、反斜杠和结构字符的位图，
+    再用位运算去掉被转义的引号，用前缀异或得到字符串内部的位图，把其中的结构字符去掉。
+    转义和字符串的状态通过上一块的进位传递，整个过程没有逐字节的分支。
+    结果按块保存为位图，占用的内存是输入的1/8。
+*/
+class StructuralIndex {
+public:
+    // 建立[data, data + len)的索引，字符串没有闭合时返回false
+    bool build(const char* data, size_t len);
+
+    // 按顺序对每个结构字符的位置调用f(pos)，f返回false时停止
+    template <typename F>
+    void for_each(F f) const {
+        for (size_t b = 0; b < bits.size(); b++) {
+            for (uint64_t m = bits[b]; m; m &= m - 1)
+                if (!f(b * 64 + __builtin_ctzll(m)))
+                    return;
+        }
+    }
+
+    const std::vector<uint64_t>& blocks() const { return bits; }
+
+private:
+    std::vector<uint64_t> bits;
+};
+
+}  // namespace myjson
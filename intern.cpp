@@ -0,0 +1,58 @@
+#include "intern.h"
+#include <algorithm>
+
+namespace myjson {
+
+Key InternPool::intern(const char* s, size_t n) {
+    if (n <= Key::max_inline)
+        return Key(s, n);
+    uint64_t h = Key::hash(s, n);
+    // 分片用哈希值的高位，分片内的表用低位
+    Shard& shard = shards[h >> 60];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if (shard.count * 2 >= shard.table.size()) {
+        std::vector<const Key::Entry*> old(std::max<size_t>(shard.table.size() * 2, 64), nullptr);
+        old.swap(shard.table);
+        size_t mask = shard.table.size() - 1;
+        for (const Key::Entry* e : old) {
+            if (!e) continue;
+            size_t k = e->hash & mask;
+            while (shard.table[k]) k = (k + 1) & mask;
+            shard.table[k] = e;
+        }
+    }
+    size_t mask = shard.table.size() - 1;
+    size_t k = h & mask;
+    for (; shard.table[k]; k = (k + 1) & mask) {
+        const Key::Entry* e = shard.table[k];
+        if (e->hash == h && e->size == n && std::memcmp(e->data(), s, n) == 0)
+            break;
+    }
+    if (!shard.table[k]) {
+        shard.table[k] = Key::make_entry(s, n, h, &shard.arena);
+        shard.count++;
+    }
+    Key key;
+    key.set_entry(shard.table[k], Key::POOL);
+    return key;
+}
+
+size_t InternPool::size() const {
+    size_t n = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        n += shard.count;
+    }
+    return n;
+}
+
+size_t InternPool::memory_used() const {
+    size_t n = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        n += shard.arena.used() + shard.table.size() * sizeof(const Key::Entry*);
+    }
+    return n;
+}
+
+}  // namespace myjson
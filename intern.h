@@ -0,0 +1,43 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include "key.h"
+
+namespace myjson {
+
+/*
+    InternPool：object的key的驻留表。同样内容的长key只保存一份，Key直接指向它，
+    不同的文档、不同的线程可以共用同一个InternPool（JsonParser::intern_keys()、Document::intern_keys()）。
+    短key本来就存放在Key内部，不进入池。
+    表分成若干个分片，每个分片有自己的锁和Arena，多个线程同时解析时很少互相等待。
+    池中的key只在池析构时释放，池必须比所有使用它的Json活得更久。
+    适合key的种类有限的数据；如果key本身是不断变化的ID，池会一直增长。
+*/
+class InternPool {
+public:
+    InternPool() = default;
+    InternPool(const InternPool&) = delete;
+    InternPool& operator=(const InternPool&) = delete;
+
+    // 返回和[s, s + n)内容相同的规范Key，线程安全
+    Key intern(const char* s, size_t n);
+    Key intern(const std::string& s) { return intern(s.data(), s.size()); }
+
+    // 池中key的个数和占用的内存
+    size_t size() const;
+    size_t memory_used() const;
+
+private:
+    static const size_t shard_count = 16;
+
+    struct Shard {
+        mutable std::mutex lock;
+        Arena arena{16 * 1024};
+        std::vector<const Key::Entry*> table;  // 开放寻址，负载不超过1/2
+        size_t count = 0;
+    };
+
+    Shard shards[shard_count];
+};
+
+}  // namespace myjson
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "arena.h"
+
+namespace myjson {
+
+class InternPool;
+
+/*
+    Key：object的key，固定16字节。
+    不超过14字节的key直接存放在Key内部，不分配内存，比较时只比较两个64位整数；
+    更长的key指向一个Entry，其中保存了预先算好的哈希值和字符。Entry可以在堆上（Key拥有它）、
+    在Arena中（随Document一起释放），或者在InternPool中（同样的key共用一个Entry，比较时先比较指针）。
+    同样的内容总是使用同一种存放方式，所以短key和长key永远不相等。
+*/
+class Key {
+    friend class InternPool;
+
+public:
+    static const size_t max_inline = 14;
+
+    struct Entry {
+        uint64_t hash;
+        uint32_t size;
+        const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+    };
+
+    Key() noexcept { std::memset(raw, 0, sizeof(raw)); }
+    Key(const char* s, size_t n) { init(s, n, nullptr); }
+    Key(const char* s) { init(s, std::strlen(s), nullptr); }
+    Key(const std::string& s) { init(s.data(), s.size(), nullptr); }
+    // 长key的Entry分配在arena中，不需要析构
+    Key(const char* s, size_t n, Arena* arena) { init(s, n, arena); }
+
+    // 拷贝出来的Key不依赖Arena：Arena中的Entry会复制到堆上，InternPool中的Entry则直接共用
+    Key(const Key& other) {
+        std::memcpy(raw, other.raw, sizeof(raw));
+        if (other.kind() == HEAP || other.kind() == ARENA)
+            set_entry(make_entry(other.data(), other.size(), other.hash(), nullptr), HEAP);
+    }
+    Key(Key&& other) noexcept {
+        std::memcpy(raw, other.raw, sizeof(raw));
+        std::memset(other.raw, 0, sizeof(raw));
+    }
+    Key& operator=(const Key& other) {
+        Key tmp(other);
+        return *this = std::move(tmp);
+    }
+    Key& operator=(Key&& other) noexcept {
+        if (this != &other) {
+            release();
+            std::memcpy(raw, other.raw, sizeof(raw));
+            std::memset(other.raw, 0, sizeof(raw));
+        }
+        return *this;
+    }
+    ~Key() { release(); }
+
+    const char* data() const { return kind() == INLINE ? raw : entry()->data(); }
+    size_t size() const { return kind() == INLINE ? static_cast<uint8_t>(raw[15]) : entry()->size; }
+    bool empty() const { return size() == 0; }
+    uint64_t hash() const { return kind() == INLINE ? hash(raw, size()) : entry()->hash; }
+    std::string str() const { return std::string(data(), size()); }
+    // 是否持有堆内存
+    bool on_heap() const { return kind() == HEAP; }
+    // 是否是InternPool中的规范副本
+    bool interned() const { return kind() == POOL; }
+
+    static uint64_t hash(const char* s, size_t n) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t k = 0; k < n; k++)
+            h = (h ^ static_cast<unsigned char>(s[k])) * 1099511628211ULL;
+        return h;
+    }
+
+    friend bool operator==(const Key& a, const Key& b) {
+        if (a.kind() == INLINE || b.kind() == INLINE)
+            return std::memcmp(a.raw, b.raw, sizeof(a.raw)) == 0;
+        const Entry* x = a.entry();
+        const Entry* y = b.entry();
+        return x == y || (x->hash == y->hash && x->size == y->size && std::memcmp(x->data(), y->data(), x->size) == 0);
+    }
+    friend bool operator!=(const Key& a, const Key& b) { return !(a == b); }
+    friend bool operator<(const Key& a, const Key& b) {
+        size_t m = a.size(), n = b.size();
+        int r = std::memcmp(a.data(), b.data(), m < n ? m : n);
+        return r != 0 ? r < 0 : m < n;
+    }
+
+    // 和一段字符比较，长key先比较哈希值
+    bool equals(const char* s, size_t n, uint64_t h) const {
+        if (kind() == INLINE)
+            return n == size() && std::memcmp(raw, s, n) == 0;
+        const Entry* e = entry();
+        return e->hash == h && e->size == n && std::memcmp(e->data(), s, n) == 0;
+    }
+
+private:
+    // raw[15]的高4位是存放方式，内联时raw[15]就是长度
+    enum Kind : uint8_t { INLINE = 0, HEAP = 0x10, ARENA = 0x20, POOL = 0x30 };
+
+    Kind kind() const { return static_cast<Kind>(static_cast<uint8_t>(raw[15]) & 0xF0); }
+    const Entry* entry() const {
+        const Entry* e;
+        std::memcpy(&e, raw, sizeof(e));
+        return e;
+    }
+    void set_entry(const Entry* e, Kind k) {
+        std::memset(raw, 0, sizeof(raw));
+        std::memcpy(raw, &e, sizeof(e));
+        raw[15] = static_cast<char>(k);
+    }
+
+    static const Entry* make_entry(const char* s, size_t n, uint64_t h, Arena* arena) {
+        size_t bytes = sizeof(Entry) + n + 1;
+        void* p = arena ? arena->allocate(bytes, alignof(Entry)) : ::operator new(bytes);
+        Entry* e = static_cast<Entry*>(p);
+        e->hash = h;
+        e->size = static_cast<uint32_t>(n);
+        char* d = reinterpret_cast<char*>(e + 1);
+        std::memcpy(d, s, n);
+        d[n] = '\0';
+        return e;
+    }
+
+    void init(const char* s, size_t n, Arena* arena) {
+        std::memset(raw, 0, sizeof(raw));
+        if (n <= max_inline) {
+            std::memcpy(raw, s, n);
+            raw[15] = static_cast<char>(n);
+        } else {
+            set_entry(make_entry(s, n, hash(s, n), arena), arena ? ARENA : HEAP);
+        }
+    }
+
+    void release() {
+        if (kind() == HEAP)
+            ::operator delete(const_cast<Entry*>(entry()));
+    }
+
+    alignas(8) char raw[16];
+};
+
+inline bool operator==(const Key& a, const std::string& b) { return a.equals(b.data(), b.size(), Key::hash(b.data(), b.size())); }
+inline bool operator==(const std::string& a, const Key& b) { return b == a; }
+inline bool operator==(const Key& a, const char* b) { return a == std::string(b); }
+inline bool operator==(const char* a, const Key& b) { return b == std::string(a); }
+
+}  // namespace myjson
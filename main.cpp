@@ -1,8 +1,24 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <unistd.h>
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 #include "myjson.h"
+#include "simd.h"
+#include "reader.h"
+#include "stream.h"
+#include "ondemand.h"
+#include "file.h"
+#include "parallel.h"
+#include "intern.h"
+#include "stats.h"
+#include "cbor.h"
+#include "bind.h"
+#include "patch.h"
+#include "schema.h"
+#include "writer.h"
 #include <cassert>
 
 // static int main_ret = 0;
@@ -41,6 +57,9 @@ static void test_parse() {
     json = Json::parse("-10");
     cout << json.number_value() << std::endl;
 
+    json = Json::parse("1234567890123456789");
+    cout << json.int64_value() << std::endl;
+
     json = Json::parse("1.12");
     cout << json.number_value() << std::endl;
 
@@ -57,13 +76,455 @@ static void test_parse() {
     cout << json.object_value().size() << std::endl;
     // cout << json.state<< std::endl;
     cout << json["a"].int_value() << std::endl;
+    cout << json.dump() << std::endl;
+    cout << json["g"].dump(4) << std::endl;
 
     // std::cout << "k1: " << json["k1"].string_value() << "\n";
     // std::cout << "k3: " << json["k3"].dump() << "\n";
 }
 
+// 用kernels的四个函数扫描buf，结果和逐字节的实现比较，返回不一致的次数
+static int compare_kernels(const simd::Kernels& k, const std::vector<char>& buf) {
+    const simd::Kernels& ref = *simd::kernels_for("scalar");
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+    int diff = 0;
+    for (const char* q = p; q <= end; q++) {
+        diff += k.skip_whitespace(q, end) != ref.skip_whitespace(q, end);
+        diff += k.scan_string(q, end) != ref.scan_string(q, end);
+    }
+    diff += k.validate_utf8(p, end) != ref.validate_utf8(p, end);
+    for (const char* q = p; end - q >= 64; q++) {
+        simd::Masks a, b;
+        k.classify(q, a);
+        ref.classify(q, b);
+        diff += a.quote != b.quote || a.backslash != b.backslash || a.op != b.op;
+    }
+    return diff;
+}
+
+static void test_simd() {
+    // 长度0到70的输入，特殊字节放在每一个位置上，跨过16和32字节的边界；buf正好是输入的长度，越界读会被ASan发现
+    const char specials[] = {' ', '\t', '\n', '\r', 'a', '"', '\\', '\x01', '\x1f', '{', ':', ','};
+    const char* utf8[] = {"\xC3\xA9", "\xE4\xBD\xA0", "\xF0\x9F\x98\x80",                 // 合法
+                          "\x80", "\xC3", "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80",       // 不合法
+                          "\xF4\x90\x80\x80", "\xF0\x9F\x98", "\xFF"};
+    for (const char* level : {"avx2", "sse2", "scalar"}) {
+        const simd::Kernels* k = simd::kernels_for(level);
+        if (!k)
+            continue;
+        int diff = 0, inputs = 0;
+        for (size_t len = 0; len <= 70; len++) {
+            for (char fill : {' ', 'a'}) {
+                for (size_t pos = 0; pos < len; pos++) {
+                    for (char ch : specials) {
+                        std::vector<char> buf(len, fill);
+                        buf[pos] = ch;
+                        diff += compare_kernels(*k, buf);
+                        inputs++;
+                    }
+                }
+            }
+            for (const char* seq : utf8) {
+                size_t n = strlen(seq);
+                for (size_t pos = 0; pos + n <= len; pos++) {
+                    std::vector<char> buf(len, 'a');
+                    memcpy(buf.data() + pos, seq, n);
+                    // 前面再放一个合法的多字节字符，让检查不能只走全ASCII的捷径
+                    if (pos >= 2)
+                        memcpy(buf.data() + pos - 2, "\xC3\xA9", 2);
+                    diff += compare_kernels(*k, buf);
+                    inputs++;
+                }
+            }
+        }
+        cout << level << " " << inputs << " " << diff << std::endl;
+    }
+}
+
+static void test_document() {
+    Document doc;
+    for (int k = 0; k < 2; k++) {
+        const Json& json = doc.parse("{\"a\":[1, 2, 3], \"b\":\"Hello\"}");
+        cout << json["a"][2].int_value() << " " << json["b"].string_value() << std::endl;
+    }
+    cout << doc.memory_used() << std::endl;
+}
+
+static void test_insitu() {
+    // 借用模式：没有转义的字符串直接指向输入；原地模式：含转义的字符串在输入中解码，输入被改写
+    char text[] = "{\"plain\": \"abc\", \"escaped\": \"a\\tb\\u4F60\"}";
+    Document doc;
+    const Json& view = doc.parse_view(text, sizeof(text) - 1);
+    StringView plain = view["plain"].string_view();
+    cout << view.dump() << " " << (plain.data() >= text && plain.data() < text + sizeof(text)) << std::endl;
+    const Json& json = doc.parse_insitu(text, sizeof(text) - 1);
+    StringView escaped = json["escaped"].string_view();
+    cout << json.dump() << " " << (escaped.data() >= text && escaped.data() < text + sizeof(text)) << " "
+         << escaped.size() << std::endl;
+}
+
+static void write_file(const char* path, const char* text) {
+    FILE* f = fopen(path, "wb");
+    fputs(text, f);
+    fclose(f);
+}
+
+static void test_file() {
+    // 普通文件用mmap读取，打不开时返回JSON_PARSE_IO_ERROR
+    const char* json_path = "/tmp/myjson_test.json";
+    const char* ndjson_path = "/tmp/myjson_test.ndjson";
+    write_file(json_path, "{\"name\": \"file\", \"values\": [1, 2, 3]}\n");
+    MappedFile file(json_path);
+    Json json = Json::parse_file(json_path);
+    cout << file.mapped() << " " << json.state << " " << json.dump() << " "
+         << Json::parse_file("/tmp/myjson_missing.json").state << std::endl;
+    // 管道不能映射，退回到用read()读进内存
+    int fds[2];
+    if (pipe(fds) == 0) {
+        const char text[] = "[\"from pipe\", 4]";
+        ssize_t written = write(fds[1], text, sizeof(text) - 1);
+        close(fds[1]);
+        string path = "/dev/fd/" + std::to_string(fds[0]);
+        cout << written << " " << Json::parse_file(path).dump() << std::endl;
+        close(fds[0]);
+    }
+    // 空行被跳过，最后一行没有换行符，出错的行带有错误码并且不影响后面的行
+    write_file(ndjson_path, "{\"id\": 1}\n\n  \n[2, 3]\n{bad}\n\"last\"");
+    NdjsonReader reader(ndjson_path);
+    Json record;
+    while (reader.next(record))
+        cout << reader.line_number() << ": " << record.state << " " << record.dump() << std::endl;
+    remove(json_path);
+    remove(ndjson_path);
+}
+
+static void test_duplicates() {
+    // 超过16个成员时对象建立哈希索引；重复的key默认保留第一次的位置和最后一次的值
+    string text = "{\"dup\": 1";
+    for (int k = 0; k < 17; k++)
+        text += ", \"k" + std::to_string(k) + "\": " + std::to_string(k);
+    text += ", \"dup\": 2}";
+    for (int keep = 0; keep < 2; keep++) {
+        JsonParser parser(text);
+        parser.keep_duplicate_keys(keep != 0);
+        Json json = parser.parse();
+        cout << json.object_value().size() << " " << json["dup"].int_value() << " " << json["k16"].int_value() << " "
+             << json.dump(0, false) << std::endl;
+    }
+}
+
+static void test_keys() {
+    // 不超过14字节的key存放在Key内部，更长的key在堆上（或Arena、InternPool中）
+    Key inline_key("fourteen_bytes"), long_key("fifteen_bytes_x");
+    cout << inline_key.size() << " " << inline_key.on_heap() << " " << long_key.size() << " " << long_key.on_heap() << std::endl;
+
+    // Arena中的key复制到堆上的Json时也被复制，Document重新解析之后仍然可以使用
+    Document doc;
+    const Json& parsed = doc.parse("{\"fourteen_bytes\": 1, \"fifteen_bytes_x\": 2}");
+    Json copy = Json(parsed.object_value());
+    doc.parse("{}");
+    cout << copy.object_value().begin()[1].first.on_heap() << " " << copy["fourteen_bytes"].int_value() << " "
+         << copy.get(long_key).int_value() << std::endl;
+
+    // 两个Document共用一个InternPool，同样的长key只保存一份，查找时只比较指针
+    InternPool pool;
+    Document a, b;
+    a.intern_keys(&pool);
+    b.intern_keys(&pool);
+    a.parse("{\"a_rather_long_field_name\": \"a\"}");
+    b.parse("{\"other\": 0, \"a_rather_long_field_name\": \"b\"}");
+    Key pooled = pool.intern("a_rather_long_field_name");
+    cout << pool.size() << " " << pooled.interned() << " " << (a.root().object_value().begin()->first == pooled) << " "
+         << a.root().get(pooled).string_value() << " " << b.root().get(pooled).string_value() << std::endl;
+
+    // 同一个JsonParser换用另一个pool之后，key来自新的pool，旧的pool可以先释放
+    string text = "{\"a_rather_long_field_name\": 1}";
+    JsonParser parser(text);
+    InternPool* old_pool = new InternPool;
+    parser.intern_keys(old_pool);
+    parser.parse();
+    delete old_pool;
+    InternPool new_pool;
+    parser.reset(text.data(), text.size());
+    parser.intern_keys(&new_pool);
+    Json second = parser.parse();
+    cout << new_pool.size() << " " << (second.object_value().begin()->first == new_pool.intern("a_rather_long_field_name"))
+         << " " << second.dump() << std::endl;
+}
+
+static void test_stats() {
+    // 两次解析的统计累加在一起；编译时定义MYJSON_NO_STATS时全部为0
+    string text = "{\"name\": \"a\\nb\", \"list\": [1, 2.5, [true, null]], \"empty\": {}}";
+    ParseStats stats;
+    JsonParser parser(text);
+    parser.collect_stats(&stats);
+    parser.parse();
+    Document doc;
+    doc.collect_stats(&stats);
+    doc.parse(text);
+    // 耗时每次都不一样，不打印
+    stats.string_ns = stats.number_ns = stats.container_ns = 0;
+    cout << stats.to_json().dump(0, false) << std::endl;
+
+    // 18个成员的对象：节点、成员数组和哈希索引三次分配，数组和索引按容量计算
+    string wide = "{";
+    for (int k = 0; k < 18; k++)
+        wide += (k ? ", \"k" : "\"k") + std::to_string(k) + "\": " + std::to_string(k);
+    wide += "}";
+    ParseStats object_stats;
+    JsonParser wide_parser(wide);
+    wide_parser.collect_stats(&object_stats);
+    wide_parser.parse();
+    cout << object_stats.allocations << " " << object_stats.allocated_bytes << std::endl;
+}
+
+// 只统计数字的个数和总和，不构造Json
+struct NumberCounter {
+    int count = 0;
+    double sum = 0;
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number(const Number& n) {
+        count++;
+        sum += n.kind == Number::DOUBLE ? n.d : n.kind == Number::INT ? n.i : n.u;
+        return true;
+    }
+    bool string(StringView) { return true; }
+    bool key(StringView) { return true; }
+    bool start_object() { return true; }
+    bool end_object(size_t) { return true; }
+    bool start_array() { return true; }
+    bool end_array(size_t) { return true; }
+};
+
+static void test_sax() {
+    string text = "{\"a\":[1, 2, 3], \"b\":{\"c\":2.5}}";
+    JsonParser parser(text);
+    NumberCounter counter;
+    State state = parser.parse(counter);
+    cout << state << " " << counter.count << " " << counter.sum << std::endl;
+}
+
+static void test_stream() {
+    // 模拟从网络上分块收到的数据，块的边界可以落在字符串和数字的中间
+    const char* chunks[] = {"[{\"id\": 1, \"name\": \"He", "llo\\u4F60\"}, {\"id\": 2", ", \"name\": \"World\"}]"};
+    StreamParser parser(true);
+    Json element;
+    for (const char* chunk : chunks) {
+        parser.feed(chunk, strlen(chunk));
+        while (parser.next(element))
+            cout << element.dump() << std::endl;
+    }
+    cout << parser.finish() << " " << parser.complete() << std::endl;
+    // 输入在字符串中间结束时，错误码和Json::parse相同
+    for (const char* cut : {"\"ab", "\"ab\\", "[\"\\u4F"}) {
+        StreamParser tail;
+        tail.feed(cut, strlen(cut));
+        cout << tail.finish() << " " << Json::parse(cut).state << " ";
+    }
+    cout << std::endl;
+}
+
+static void test_parallel() {
+    // 超过1MiB的数组按元素分给4个线程解析，结果和串行解析相同
+    string big = "[";
+    for (int k = 0; k < 40000; k++)
+        big += (k ? "," : "") + string("{\"id\": ") + std::to_string(k) + ", \"name\": \"item\\u4F60\", \"tags\": [1.5, null]}";
+    big += "]";
+    Json serial = Json::parse(big), parallel = Json::parse_parallel(big.data(), big.size(), 4);
+    cout << big.size() << " " << parallel.state << " " << parallel.array_value().size() << " " << (serial.dump() == parallel.dump()) << std::endl;
+    // 中间的一个元素有语法错误时退回串行解析，得到和Json::parse相同的错误
+    big[big.find("null", big.size() / 2) + 3] = 'x';
+    serial = Json::parse(big);
+    parallel = Json::parse_parallel(big.data(), big.size(), 4);
+    cout << serial.state << " " << parallel.state << std::endl;
+}
+
+static void test_parallel_ndjson() {
+    // 块很小时每个线程要处理很多块，先做完的线程会去偷别的线程的块；结果和NdjsonReader逐行读取相同
+    string text;
+    for (int k = 0; k < 300; k++) {
+        text += k == 150 ? "{\"id\": oops}" : "{\"id\": " + std::to_string(k) + ", \"name\": \"line\\n" + std::to_string(k) + "\"}";
+        text += k % 50 == 0 ? "\n  \n" : "\n";
+    }
+    text += "[\"last\", \"without newline\"]";
+    NdjsonReader reader(text.data(), text.size()), lines(text.data(), text.size());
+    std::vector<Json> expected;
+    std::unordered_map<size_t, size_t> index;     // 行在输入中的偏移 -> 行的序号
+    StringView line;
+    for (Json record; reader.next(record);)
+        expected.push_back(record);
+    while (lines.next_line(line))
+        index.emplace(line.data() - text.data(), index.size());
+
+    for (size_t chunk_size : {1, 64, 1000}) {
+        ParallelNdjson parallel(4, chunk_size);
+        std::vector<Json> records = parallel.parse(text.data(), text.size());
+        bool same = records.size() == expected.size();
+        for (size_t k = 0; same && k < records.size(); k++)
+            same = records[k].state == expected[k].state && records[k].dump() == expected[k].dump();
+        // callback在工作线程中调用，每一行写到自己的位置上，不需要加锁
+        std::vector<Json> by_offset(index.size());
+        std::vector<char> seen(index.size(), 0);
+        parallel.parse(text.data(), text.size(), [&](size_t offset, Json& record) {
+            size_t k = index.at(offset);
+            seen[k]++;
+            by_offset[k] = record;
+        });
+        bool same_callback = true;
+        for (size_t k = 0; k < expected.size(); k++)
+            same_callback = same_callback && seen[k] == 1 && by_offset[k].state == expected[k].state &&
+                            by_offset[k].dump() == expected[k].dump();
+        cout << chunk_size << " " << records.size() << " " << same << " " << same_callback << " "
+             << records[150].state << " " << records.back().dump() << std::endl;
+    }
+}
+
+static void test_path() {
+    // 路径只编译一次，之后可以用在很多文档上
+    Path id("/user/id"), second("items[1].name");
+    const char* docs[] = {"{\"user\": {\"name\": \"a\", \"id\": 1}, \"items\": [{\"name\": \"x\"}, {\"name\": \"y\"}]}",
+                          "{\"items\": [], \"user\": {\"id\": 2}}"};
+    for (const char* doc : docs) {
+        Json a = id.extract(doc), b = second.extract(doc);
+        cout << a.dump() << " " << b.dump() << " " << b.state << std::endl;
+    }
+    // 重复的key和Json::parse一样取最后一个，路径经过的对象有语法错误时报告错误
+    const char* dup = "{\"user\": {\"id\": 1}, \"user\": {\"id\": 2, \"id\": 3}}";
+    StringView raw;
+    cout << id.extract(dup).dump() << " " << Json::parse(dup)["user"]["id"].dump() << " " << id.locate(dup, strlen(dup), raw)
+         << " " << raw.to_string() << " " << id.extract("{\"user\": {\"id\": 1,}}").state << std::endl;
+}
+
+struct Point {
+    double x = 0, y = 0;
+};
+MYJSON_BIND(Point, x, y)
+
+struct Shape {
+    string name;
+    std::vector<Point> points;
+    Json style;     // 结构不固定的部分仍然是Json
+};
+MYJSON_BIND(Shape, name, points, style)
+
+static void test_bind() {
+    Shape shape;
+    State state = parse_into(string("{\"name\": \"line\", \"points\": [{\"x\": 1, \"y\": 2}, {\"y\": 3}], \"style\": {\"w\": 2}}"), shape);
+    cout << state << " " << shape.name << " " << shape.points[1].y << " " << shape.style["w"].int_value() << std::endl;
+    cout << to_json(shape).dump() << std::endl;
+
+    // 类型不符时字段保持原来的值；输入中后面的语法错误优先于类型不符
+    Point point;
+    point.x = 5;
+    State mismatch = from_json(Json::parse("{\"x\": \"s\"}"), point);
+    cout << mismatch << " " << point.x << " " << parse_into(string("{\"x\": \"s\", \"y\": 1}"), point) << " "
+         << parse_into(string("{\"x\": \"s\" "), point) << " " << parse_into(string("{\"x\": \"s\"} 1"), point) << std::endl;
+}
+
+static void test_cbor() {
+    Json json = Json::parse("{\"id\": 7, \"tags\": [\"a\", \"b\"], \"score\": 1.5}");
+    string bin = encode_cbor(json);
+    // 不解码，直接在二进制数据上访问
+    CborView view(bin);
+    cout << bin.size() << " " << view["id"].int64_value() << " " << view["tags"][1].string_view().to_string() << std::endl;
+    cout << decode_cbor(bin).dump() << std::endl;
+
+    // 重复的key和解码、解析JSON一样取最后一个；嵌套太深时返回JSON_PARSE_TOO_DEEP
+    string dup = "\xA2\x61k\x01\x61k\x02";
+    string deep_array(2000, '\x81'), deep_tag(2000, '\xC1');
+    deep_array += '\x00';
+    deep_tag += '\x00';
+    string deep_member = "\xA2\x61" "a" + deep_array + "\x61" "b\x01";
+    cout << CborView(dup)["k"].int64_value() << " " << decode_cbor(dup).dump() << " " << decode_cbor(deep_array).state << " "
+         << CborView(deep_array).decode().state << " " << CborView(deep_tag).state() << " "
+         << CborView(deep_member)["b"].state() << std::endl;
+}
+
+static void test_patch() {
+    Json doc = Json::parse("{\"user\": {\"name\": \"a\", \"password\": \"x\"}, \"items\": [1, 2]}");
+    Json copy = doc;
+    // 只复制根和user，items仍然和doc共享
+    merge_patch(copy, Json::parse("{\"user\": {\"password\": null}}"));
+    State state = apply_patch(copy, Json::parse("[{\"op\": \"add\", \"path\": \"/items/-\", \"value\": 3}]"));
+    cout << state << " " << copy.dump() << " " << doc.dump() << std::endl;
+}
+
+static void test_validate() {
+    // 不构造Json，错误码和位置与解析时相同
+    size_t offset;
+    string bad = "{\"name\": \"caf\xC3\"}";
+    State state = Json::validate(bad, &offset);
+    JsonParser parser(bad);
+    parser.strict_utf8();
+    cout << state << " " << offset << " " << parser.parse().state << " " << Json::parse(bad).state << std::endl;
+}
+
+static void test_depth() {
+    // 恶意的深层嵌套不会耗尽栈，超过限制时返回错误
+    string deep(100000, '[');
+    JsonParser parser(deep);
+    parser.limit_depth(64);
+    cout << parser.parse().state << " " << parser.get_index() << " " << Json::validate(deep) << std::endl;
+}
+
+static void test_compare() {
+    // 成员的顺序和数字的写法不影响相等，可以直接作为unordered_set的key
+    std::unordered_set<Json> seen;
+    const char* bodies[] = {"{\"q\": \"a\", \"page\": 1}", "{\"page\": 1.0, \"q\": \"a\"}", "{\"q\": \"b\"}"};
+    for (const char* body : bodies)
+        seen.insert(Json::parse(body));
+    cout << seen.size() << " " << (Json::parse("[1, 2]") < Json::parse("[1, 3]")) << std::endl;
+}
+
+static void test_writer() {
+    // 不构造Json，直接输出
+    string out;
+    Writer w(out, 2);
+    w.begin_object().key("id").value(7).key("tags").begin_array().value("a").value(1.5).end_array().end_object();
+    cout << out << std::endl;
+    // 各种整数类型都按有无符号输出
+    string numbers;
+    Writer(numbers).begin_array().value(-1).value(4000000000u).value(uint32_t(7)).value(-9000000000LL)
+        .value(18446744073709551615ULL).value(short(-2)).value(size_t(3)).value(true).end_array();
+    cout << numbers << std::endl;
+}
+
+static void test_schema() {
+    // 编译一次，之后检查每个请求；出错时得到不符合的值的位置
+    JsonSchema schema(Json::parse("{\"type\": \"object\", \"required\": [\"id\"], \"additionalProperties\": false,"
+                                  "\"properties\": {\"id\": {\"type\": \"integer\", \"minimum\": 1},"
+                                  "\"tags\": {\"type\": \"array\", \"items\": {\"type\": \"string\"}}}}"));
+    string pointer;
+    State state = schema.validate(Json::parse("{\"id\": 7, \"tags\": [\"a\", 2]}"), &pointer);
+    cout << state << " " << pointer;
+    state = schema.validate_text(string("{\"id\": 7, \"debug\": true}"), &pointer);
+    cout << " " << state << " " << pointer << std::endl;
+}
+
 int main() {
     test_parse();
+    test_simd();
+    test_document();
+    test_insitu();
+    test_duplicates();
+    test_keys();
+    test_stats();
+    test_sax();
+    test_stream();
+    test_file();
+    test_parallel();
+    test_parallel_ndjson();
+    test_path();
+    test_cbor();
+    test_bind();
+    test_patch();
+    test_validate();
+    test_depth();
+    test_compare();
+    test_writer();
+    test_schema();
     // printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count,test_pass *
     // 100.0 / test_count);
     return 0;
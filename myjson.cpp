@@ -1,92 +1,83 @@
 #include "myjson.h"
+#include "intern.h"
+#include "reader.h"
+#include "stats.h"
+#include "simd.h"
+#include "number.h"
 #include <limits>
 #include <cstdio>
 #include <cmath>
 #include <memory>
+#include <cstring>
+#include <chrono>
 
 // JsonValue的各种派生类和模板特化
 namespace myjson {
 
-using std::make_shared;
 using std::move;
 // using std::shared_ptr;
 using std::string;
 
-struct NullStruct {
-    bool operator==(NullStruct) const { return true; }
-    bool operator<(NullStruct) const { return false; }
-};
-
 template <Json::Type t, typename T>
 class Value : public JsonValue {
-protected:
-    const T value;
+public:
+    static const uint8_t json_tag = t;
+    T value;    // 只在节点没有被共享时修改，同时清除缓存的hash，见Json::mutable_array()
 
+protected:
     explicit Value(const T& v) : value(v) {}
     explicit Value(T&& v) : value(move(v)) {}
-
-    Json::Type type() const override { return t; }
-};
-
-class JsonNull final : public Value<Json::JSON_NULL, NullStruct> {
-public:
-    explicit JsonNull() : Value({}) {}
 };
 
-class JsonBool final : public Value<Json::JSON_BOOL, bool> {
-    bool bool_value() const { return value; }
-
-public:
-    explicit JsonBool(bool v) : Value(v) {}
-};
-
-class JsonInt final : public Value<Json::JSON_NUMBER, int> {
-    double number_value() const { return value; }
-    int int_value() const { return value; }
-
+class JsonString final : public Value<Json::JSON_STRING, string> {
 public:
-   explicit JsonInt(int v) : Value(v) {}
+    JsonString(const string &v) : Value(v) {}
+    JsonString(string &&v): Value(move(v)) {}
 };
 
-class JsonDouble final : public Value<Json::JSON_NUMBER, double> {
-    double number_value() const { return value; }
-    // 使用static_cast安全转型
-    int int_value() const { return static_cast<int>(value); }
-
+/*
+    借用模式下的字符串，只在Document中出现。
+    需要std::string时才复制一份，多个线程同时调用时只有一个副本会被保留。
+*/
+class JsonStringView final : public Value<Json::JSON_STRING, StringView> {
 public:
-    JsonDouble(double v) : Value(v) {}
-};
+    static const uint8_t json_tag = Json::TAG_STRING_VIEW;
+
+    explicit JsonStringView(StringView v) : Value(v) {}
+    ~JsonStringView() { delete copy.load(std::memory_order_acquire); }
+
+    const string& to_string() const {
+        string* s = copy.load(std::memory_order_acquire);
+        if (!s) {
+            string* fresh = new string(value.data(), value.size());
+            if (copy.compare_exchange_strong(s, fresh, std::memory_order_acq_rel))
+                s = fresh;
+            else
+                delete fresh;
+        }
+        return *s;
+    }
 
-class JsonString final : public Value<Json::JSON_STRING, string> {
-    const string& string_value() const { return value; }
-public:
-    JsonString(const string &v) : Value(v) {}
-    JsonString(string &&v): Value(move(v)) {}
+private:
+    mutable std::atomic<string*> copy{nullptr};
 };
 
 class JsonArray final : public Value<Json::JSON_ARRAY, Json::array> {
-    const Json::array& array_value() const override { return value; }
-    const Json& operator[] (size_t i) const override;
 public:
      JsonArray(const Json::array& v): Value(v) {}
      JsonArray(Json::array&& v): Value(move(v)) {}
 };
 
 class JsonObject final : public Value<Json::JSON_OBJECT, Json::object> {
-    const Json::object& object_value() const override { return value; }
-    const Json& operator[] (const string& key) const override;
 public:
     JsonObject(const Json::object& v): Value(v) {}
     JsonObject(Json::object&& v): Value(move(v)) {}
 };
 
 /*
-    使用单例模式，创建一系列可以公用的静态值和动态值的初始值。
+    使用单例模式，创建一系列可以公用的静态值。
 */
 struct Singleton {
-    const std::shared_ptr<JsonValue> null = make_shared<JsonNull>();
-    const std::shared_ptr<JsonValue> t = make_shared<JsonBool>(true);
-    const std::shared_ptr<JsonValue> f = make_shared<JsonBool>(false);
     const string empty_string;
     const Json::array empty_array;
     const Json::object empty_object;
@@ -105,164 +96,529 @@ static const Json& static_null() {
     return json_null;
 }
 
-// JsonValue的默认值返回函数
-// 这里留一个问题，这样的设计是每种类型的值都有对应的取值函数，特化子类用对应的取值方法覆盖默认方法。
-// 为什么不设计为统一接口，根据模板来推导返回值类型呢？
-bool                JsonValue::bool_value()                     const { return false; }
-double              JsonValue::number_value()                   const { return 0; }
-int                 JsonValue::int_value()                      const { return 0; }
-const string&       JsonValue::string_value()                   const { return singleton().empty_string; }
-const Json::array&  JsonValue::array_value()                    const { return singleton().empty_array; }
-const Json::object& JsonValue::object_value()                   const { return singleton().empty_object; }
-const Json& JsonValue::operator[](size_t i) const {
-    return static_null();
-}
-const Json& JsonValue::operator[](const string& key) const {
-    return static_null();
-}
 /*
     Json
 */
 
-// 获取Json的类型
-Json::Type Json::type() const { return v_ptr->type(); }
-
-// Json的一系列构造函数
-Json::Json() noexcept:                  v_ptr(singleton().null) {}
-Json::Json(State s) :                   v_ptr(singleton().null), state(s) {}
-Json::Json(bool value) :                v_ptr(make_shared<JsonBool>(value)) {}
-Json::Json(int value) :                 v_ptr(make_shared<JsonInt>(value)) {}
-Json::Json(double value) :              v_ptr(make_shared<JsonDouble>(value)) {}
-Json::Json(const string& value):        v_ptr(make_shared<JsonString>(value)) {}
-Json::Json(string&& value):             v_ptr(make_shared<JsonString>(move(value))) {}
-Json::Json(const char* value):          v_ptr(make_shared<JsonString>(value)) {}
-Json::Json(const Json::array& value):   v_ptr(make_shared<JsonArray>(value)) {}
-Json::Json(Json::array&& value):        v_ptr(make_shared<JsonArray>(move(value))) {}
-Json::Json(const Json::object& value):  v_ptr(make_shared<JsonObject>(value)) {}
-Json::Json(Json::object&& value):       v_ptr(make_shared<JsonObject>(move(value))) {}
+// Json的一系列构造函数，字符串、数组和对象在堆上创建节点，引用计数从1开始
+Json::Json(const string& value):        Json(new JsonString(value), JSON_STRING, true) {}
+Json::Json(string&& value):             Json(new JsonString(move(value)), JSON_STRING, true) {}
+Json::Json(const char* value):          Json(new JsonString(value), JSON_STRING, true) {}
+Json::Json(const Json::array& value):   Json(new JsonArray(value), JSON_ARRAY, true) {}
+Json::Json(Json::array&& value):        Json(new JsonArray(move(value)), JSON_ARRAY, true) {}
+Json::Json(const Json::object& value):  Json(new JsonObject(value), JSON_OBJECT, true) {}
+Json::Json(Json::object&& value):       Json(new JsonObject(move(value)), JSON_OBJECT, true) {}
+
+// 最后一个引用释放时，根据类型标记删除对应的节点
+void Json::release() {
+    if (u.p->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    switch (tag) {
+        case TAG_STRING: delete static_cast<JsonString*>(u.p); break;
+        case TAG_ARRAY:  delete static_cast<JsonArray*>(u.p); break;
+        case TAG_OBJECT: delete static_cast<JsonObject*>(u.p); break;
+        default: assert(false);
+    }
+}
 
 // Json的访问器
-bool Json::bool_value()                             const { return v_ptr->bool_value(); }
-int Json::int_value()                               const { return v_ptr->int_value(); }
-double Json::number_value()                         const { return v_ptr->number_value(); }
-const string& Json::string_value()                  const { return v_ptr->string_value(); }
-const Json::array& Json::array_value()              const { return v_ptr->array_value(); }
-const Json::object& Json::object_value()            const { return v_ptr->object_value(); }
-const Json& Json::operator[] (size_t i)             const { return (*v_ptr)[i]; }
-const Json& Json::operator[] (const string& key)    const { return (*v_ptr)[key]; }
-
-const Json& JsonArray::operator[] (size_t i) const {
-    if (i >= value.size())
+const string& Json::string_value() const {
+    if (tag == TAG_STRING)
+        return static_cast<const JsonString*>(u.p)->value;
+    if (tag == TAG_STRING_VIEW)
+        return static_cast<const JsonStringView*>(u.p)->to_string();
+    return singleton().empty_string;
+}
+
+StringView Json::string_view() const {
+    if (tag == TAG_STRING)
+        return static_cast<const JsonString*>(u.p)->value;
+    if (tag == TAG_STRING_VIEW)
+        return static_cast<const JsonStringView*>(u.p)->value;
+    return StringView();
+}
+
+const Json::array& Json::array_value() const {
+    return tag == TAG_ARRAY ? static_cast<const JsonArray*>(u.p)->value : singleton().empty_array;
+}
+
+const Json::object& Json::object_value() const {
+    return tag == TAG_OBJECT ? static_cast<const JsonObject*>(u.p)->value : singleton().empty_object;
+}
+
+const Json& Json::operator[] (size_t i) const {
+    if (tag != TAG_ARRAY)
+        return static_null();
+    const Json::array& a = static_cast<const JsonArray*>(u.p)->value;
+    return i < a.size() ? a[i] : static_null();
+}
+
+const Json& Json::operator[] (const string& key) const {
+    if (tag != TAG_OBJECT)
         return static_null();
-    else return value[i];
+    const Json::object& o = static_cast<const JsonObject*>(u.p)->value;
+    auto iter = o.find(key);
+    return (iter == o.end()) ? static_null() : iter->second;
+}
+
+const Json& Json::get(const Key& key) const {
+    if (tag != TAG_OBJECT)
+        return static_null();
+    const Json::object& o = static_cast<const JsonObject*>(u.p)->value;
+    auto iter = o.find(key);
+    return (iter == o.end()) ? static_null() : iter->second;
+}
+
+/*
+    写时复制：只有Json持有节点唯一的引用计数时才能直接修改，否则复制到堆上。
+    复制只是浅拷贝，元素增加引用计数而不会递归复制。Arena中的节点没有引用计数，总是复制
+*/
+bool Json::unique() const {
+    return owns && u.p->refs.load(std::memory_order_acquire) == 1;
+}
+
+Json::array* Json::mutable_array() {
+    if (tag != TAG_ARRAY)
+        return nullptr;
+    if (!unique()) {
+        const Json::array& old = static_cast<const JsonArray*>(u.p)->value;
+        *this = Json(Json::array(old.begin(), old.end()));
+    }
+    u.p->hash_code.store(0, std::memory_order_relaxed);
+    return &static_cast<JsonArray*>(u.p)->value;
+}
+
+Json::object* Json::mutable_object() {
+    if (tag != TAG_OBJECT)
+        return nullptr;
+    if (!unique()) {
+        // 直接拷贝会沿用Arena分配器，所以逐个添加到使用堆的FlatMap中
+        const Json::object& old = static_cast<const JsonObject*>(u.p)->value;
+        Json::object copy;
+        copy.reserve(old.size());
+        for (auto& kv : old)
+            copy.push_back(kv);
+        *this = Json(move(copy));
+    }
+    u.p->hash_code.store(0, std::memory_order_relaxed);
+    return &static_cast<JsonObject*>(u.p)->value;
+}
+
+Json* Json::edit(size_t i) {
+    if (tag != TAG_ARRAY || i >= array_value().size())
+        return nullptr;
+    return &(*mutable_array())[i];
+}
+
+Json* Json::edit(const string& key) {
+    // 先在共享的节点中查找，key不存在时不需要复制
+    if (tag != TAG_OBJECT || object_value().find(key) == object_value().end())
+        return nullptr;
+    Json::object* o = mutable_object();
+    return &o->find(key)->second;
+}
+
+bool Json::set(const string& key, Json value) {
+    if (tag == TAG_NULL)
+        *this = Json(Json::object());
+    Json::object* o = mutable_object();
+    if (!o)
+        return false;
+    o->assign(Json::object::value_type(Key(key), move(value)));
+    return true;
 }
 
-const Json& JsonObject::operator[] (const string& key) const {
-    auto iter = value.find(key);
-    return (iter == value.end()) ? static_null() : iter->second;
+bool Json::erase(const string& key) {
+    if (tag != TAG_OBJECT || object_value().find(key) == object_value().end())
+        return false;
+    mutable_object()->erase(key);
+    return true;
+}
+
+bool Json::set(size_t i, Json value) {
+    Json* e = edit(i);
+    if (!e)
+        return false;
+    *e = move(value);
+    return true;
+}
+
+bool Json::insert(size_t i, Json value) {
+    if (tag == TAG_NULL)
+        *this = Json(Json::array());
+    if (tag != TAG_ARRAY || i > array_value().size())
+        return false;
+    Json::array* a = mutable_array();
+    a->insert(a->begin() + i, move(value));
+    return true;
+}
+
+bool Json::erase(size_t i) {
+    if (tag != TAG_ARRAY || i >= array_value().size())
+        return false;
+    Json::array* a = mutable_array();
+    a->erase(a->begin() + i);
+    return true;
+}
+
+bool Json::push_back(Json value) {
+    if (tag == TAG_NULL)
+        *this = Json(Json::array());
+    Json::array* a = mutable_array();
+    if (!a)
+        return false;
+    a->push_back(move(value));
+    return true;
 }
 
 /*
     JsonParser
 */
 
-// JsonParser
+// 判断字符串是否占用了堆内存（没有被短字符串优化存放在对象内部）
+static bool owns_heap(const string& s) {
+    const char* p = s.data();
+    const char* self = reinterpret_cast<const char*>(&s);
+    return p < self || p >= self + sizeof(s);
+}
+
+// arena中对象的key不会在堆上
+static bool owns_heap(const Json::object&) { return false; }
+
+// arena中数组的元素都不持有引用计数，不需要析构
+static bool owns_heap(const Json::array&) { return false; }
+// 借用的字符串可能在之后复制出一个std::string
+static bool owns_heap(StringView) { return true; }
+
+/*
+    统计：没有打开时每个统计点只判断一次stats指针，定义MYJSON_NO_STATS时统计代码成为死代码被完全去掉
+*/
+#ifndef MYJSON_NO_STATS
+#define MYJSON_STAT(stmt) do { if (stats) { stmt; } } while (0)
+#else
+#define MYJSON_STAT(stmt) do { if (false) { stmt; } } while (0)
+#endif
+
+// 把作用域内经过的时间累加到*total，total为空时不读时钟
+class StatTimer {
+public:
+    explicit StatTimer(uint64_t* total) : total(total) {
+        if (total) start = std::chrono::steady_clock::now();
+    }
+    ~StatTimer() {
+        if (total)
+            *total += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    uint64_t* total;
+    std::chrono::steady_clock::time_point start;
+};
+
+#ifndef MYJSON_NO_STATS
+#define MYJSON_TIMER(field) StatTimer stat_timer(stats ? &stats->field : nullptr)
+#else
+#define MYJSON_TIMER(field) do {} while (0)
+#endif
+
+static void count_heap(ParseStats* s, size_t bytes) {
+    s->allocations++;
+    s->allocated_bytes += bytes;
+}
+
+// 节点内部在堆上分配的内存，heap表示容器的存储是否在堆上
+static void count_payload(ParseStats* s, const string& v, bool) {
+    if (owns_heap(v)) count_heap(s, v.capacity() + 1);
+}
+static void count_payload(ParseStats* s, const Json::array& v, bool heap) {
+    if (heap && v.capacity()) count_heap(s, v.capacity() * sizeof(Json));
+}
+static void count_payload(ParseStats* s, const Json::object& v, bool heap) {
+    if (heap) {
+        s->allocations += v.allocations();
+        s->allocated_bytes += v.allocated_bytes();
+    }
+}
+static void count_payload(ParseStats*, StringView, bool) {}
+
+/*
+    构造节点：没有arena时在堆上创建，由引用计数管理；
+    有arena时节点构造在arena中，Json不持有引用计数，拷贝时也没有原子操作。
+    只有内部还持有堆内存的节点才需要在arena reset时析构。
+*/
+template <typename T, typename V>
+Json JsonParser::make_value(V&& v) {
+    MYJSON_STAT(count_payload(stats, v, !arena));
+    if (!arena) {
+        MYJSON_STAT(count_heap(stats, sizeof(T)));
+        return Json(new T(std::forward<V>(v)), T::json_tag, true);
+    }
+    bool cleanup = owns_heap(v);
+    T* node = arena->create<T>(std::forward<V>(v));
+    if (cleanup)
+        arena->own(node);
+    return Json(node, T::json_tag, false);
+}
+
+/*
+    构造对象的key：短key存放在Key内部；长key在有pool时取规范副本，否则放在arena或者堆上。
+    每个JsonParser缓存最近从pool取得的key，同一个文档中反复出现的key不需要每次都加锁。
+*/
+Key JsonParser::make_key(StringView s) {
+    if (!pool || s.size() <= Key::max_inline) {
+        MYJSON_STAT(if (!arena && s.size() > Key::max_inline) count_heap(stats, sizeof(Key::Entry) + s.size() + 1));
+        return Key(s.data(), s.size(), arena);
+    }
+    uint64_t h = Key::hash(s.data(), s.size());
+    if (key_cache.empty())
+        key_cache.resize(256);
+    Key& cached = key_cache[h & 255];
+    if (!cached.equals(s.data(), s.size(), h))
+        cached = pool->intern(s.data(), s.size());
+    return cached;
+}
+
+Json JsonParser::parse() {
+    size_t arena_before = arena ? arena->used() : 0;
+    Json res = parse_json();
+    MYJSON_STAT(stats->parses++; stats->bytes += i; if (arena) stats->arena_bytes += arena->used() - arena_before);
+    if (failed)
+        return Json(res.state);
+    MYJSON_STAT(stats->nodes[res.type()]++);
+    parse_whitespace();
+    if (i != length)
+        return fail(Json(JSON_PARSE_ROOT_NOT_SINGULAR));
+    return res;
+}
+
+/*
+    解析一个完整的值。数组和对象不递归解析，而是在stack中记录每一层还没有结束的容器，
+    所以嵌套的深度只受max_depth限制而和线程的栈大小无关。
+    容器的元素先放在scratch（对象的成员放在members）中，容器结束后一次性移动到大小正好的存储里；
+    对象的成员在读到key时先放入members，值解析完后再填入，这时它一定是members的最后一个。
+    任何错误都从unwind()返回，此时i就是出错的位置。
+*/
 Json JsonParser::parse_json() {
+    size_t bottom = stack.size();
+    Json value;
     char ch = get_next_token();
-    switch (ch) {
-        case 'n': return parse_literal("null", Json());
-        case 't': return parse_literal("true", Json(true));
-        case 'f': return parse_literal("false", Json(false));
-        case '"': return parse_string();
-        case '[': return parse_array();
-        case '{': return parse_object();
-        case '\0': return Json(JSON_PARSE_EXPECT_VALUE);
-        default: i--; return parse_number();
+    while (true) {
+        switch (ch) {
+            case 'n':
+                if (!match_literal("null")) return unwind(bottom, JSON_PARSE_INVALID_VALUE);
+                value = Json();
+                break;
+            case 't':
+                if (!match_literal("true")) return unwind(bottom, JSON_PARSE_INVALID_VALUE);
+                value = Json(true);
+                break;
+            case 'f':
+                if (!match_literal("false")) return unwind(bottom, JSON_PARSE_INVALID_VALUE);
+                value = Json(false);
+                break;
+            case '"': {
+                MYJSON_TIMER(string_ns);
+                if (borrow) {
+                    StringView v = parse_string_view();
+                    if (failed) return unwind(bottom, error);
+                    value = make_value<JsonStringView>(v);
+                } else {
+                    string s = parse_string();
+                    if (failed) return unwind(bottom, error);
+                    value = make_value<JsonString>(move(s));
+                }
+                break;
+            }
+            case '[':
+            case '{':
+                if (stack.size() - bottom >= max_depth)
+                    return unwind(bottom, JSON_PARSE_TOO_DEEP);
+                stack.push_back(Frame{ch == '{', ch == '{' ? members.size() : scratch.size()});
+                MYJSON_STAT(if (stack.size() - bottom > stats->max_depth) stats->max_depth = stack.size() - bottom);
+                ch = get_next_token();
+                if (ch == (stack.back().object ? '}' : ']')) {
+                    value = close_container();
+                    break;
+                }
+                if (stack.back().object && !read_key(ch))
+                    return unwind(bottom, error);
+                continue;
+            case '\0':
+                return unwind(bottom, JSON_PARSE_EXPECT_VALUE);
+            default:
+                i--;
+                value = parse_number();
+                if (failed) return unwind(bottom, value.state);
+        }
+        // 把完成的值交给所在的容器，容器也结束时继续交给上一层
+        while (true) {
+            if (stack.size() == bottom)
+                return value;
+            MYJSON_STAT(stats->nodes[value.type()]++);
+            bool object = stack.back().object;
+            if (object)
+                members.back().second = move(value);
+            else
+                scratch.push_back(move(value));
+            ch = get_next_token();
+            if (ch == (object ? '}' : ']')) {
+                value = close_container();
+                continue;
+            }
+            if (ch != ',')
+                return unwind(bottom, object ? JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+                                             : JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET);
+            ch = get_next_token();
+            if (object && !read_key(ch))
+                return unwind(bottom, error);
+            break;
+        }
     }
 }
 
+// 读取对象成员的key和冒号，ch是key的第一个字符，成功时ch是值的第一个字符
+bool JsonParser::read_key(char& ch) {
+    if (ch != '"')
+        return fail(false, JSON_PARSE_MISS_KEY);
+    {
+        MYJSON_TIMER(string_ns);
+        Key key = make_key(parse_string_ref());
+        if (failed)
+            return false;
+        members.emplace_back(move(key), Json());
+    }
+    if (get_next_token() != ':')
+        return fail(false, JSON_PARSE_MISS_COLON);
+    ch = get_next_token();
+    return true;
+}
+
+// 结束最内层的容器，把暂存的元素移动到数组或对象中
+Json JsonParser::close_container() {
+    MYJSON_TIMER(container_ns);
+    Frame top = stack.back();
+    stack.pop_back();
+    if (!top.object) {
+        Json::array a(std::make_move_iterator(scratch.begin() + top.base),
+                      std::make_move_iterator(scratch.end()),
+                      Json::array::allocator_type(arena));
+        scratch.erase(scratch.begin() + top.base, scratch.end());
+        return make_value<JsonArray>(move(a));
+    }
+    Json::object o{Json::object::allocator_type(arena)};
+    o.reserve(members.size() - top.base);
+    for (size_t k = top.base; k < members.size(); k++) {
+        // 重复的key以最后一次出现的为准
+        if (duplicates)
+            o.push_back(move(members[k]));
+        else
+            o.assign(move(members[k]));
+    }
+    members.erase(members.begin() + top.base, members.end());
+    return make_value<JsonObject>(move(o));
+}
+
+// 出错时丢弃这次parse_json()中所有未完成的容器
+Json JsonParser::unwind(size_t bottom, State s) {
+    if (stack.size() > bottom) {
+        // 外层容器的base总是更小，所以从内向外覆盖，得到的是最外层的数组和对象的base
+        size_t scratch_base = scratch.size(), members_base = members.size();
+        for (size_t k = stack.size(); k-- > bottom;)
+            (stack[k].object ? members_base : scratch_base) = stack[k].base;
+        scratch.erase(scratch.begin() + scratch_base, scratch.end());
+        members.erase(members.begin() + members_base, members.end());
+        stack.erase(stack.begin() + bottom, stack.end());
+    }
+    return fail(Json(s), s);
+}
+
 // 解析空白字符
+static inline bool is_whitespace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+// 大多数token之间没有空白或者只有一个空格，先逐字节判断，较长的缩进再交给SIMD跳过
 void JsonParser::parse_whitespace() {
-    while (str[i] == ' ' || str[i] == '\t' || str[i] == '\n' || str[i] == '\r')
-        i++;
+    if (i == length || !is_whitespace(str[i]))
+        return;
+    if (++i == length || !is_whitespace(str[i]))
+        return;
+    i = simd::skip_whitespace(str + i, str + length) - str;
 }
 
 // 增加i使跳过空白字符，获得下一个token的起始字符
 char JsonParser::get_next_token() {
     parse_whitespace();
-    if (i == str.size())
+    if (i == length)
         return fail('\0');
     return str[i++];
 }
 
-// 解析null, bool这样的字面量
-Json JsonParser::parse_literal(const string& expected, Json res) {
+namespace {
+
+// 什么也不做的SAX handler，用来检查并跳过不需要的值
+struct Skipper {
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number(const Number&) { return true; }
+    bool string(StringView) { return true; }
+    bool key(StringView) { return true; }
+    bool start_object() { return true; }
+    bool end_object(size_t) { return true; }
+    bool start_array() { return true; }
+    bool end_array(size_t) { return true; }
+};
+
+}  // namespace
+
+bool JsonParser::skip_value() {
+    Skipper skipper;
+    return sax_value(skipper);
+}
+
+State JsonParser::validate() {
+    strict = discard = true;
+    Skipper skipper;
+    return parse(skipper);
+}
+
+// 解析null, bool这样的字面量，第一个字符已经被读过
+bool JsonParser::match_literal(const char* expected) {
     assert(i != 0);
     i--;
-    if (str.compare(i, expected.length(), expected) == 0) {
-        i += expected.length();
-        return res;
-    } else {
-        return fail(Json(JSON_PARSE_INVALID_VALUE));
+    size_t n = std::strlen(expected);
+    if (length - i >= n && std::memcmp(str + i, expected, n) == 0) {
+        i += n;
+        return true;
     }
+    return false;
 }
 
 static inline bool in_range(char x, char lower, char upper) {
     return (x >= lower && x <= upper);
 }
 
-// 利用std::strtod来将字符串解析为number
-/*
-number = [ "-" ] int [ frac ] [ exp ]
-int = "0" / digit1-9 *digit
-frac = "." 1*digit
-exp = ("e" / "E") ["-" / "+"] 1*digit
-*/
+// 数字的语法检查和转换在scan_number中一次完成
 Json JsonParser::parse_number() {
-    size_t start = i;  //记录起始位置
-
-    // 可选的负号部分
-    if (str[i] == '-') i++;  //跳过负号
-
-    // int部分
-    if (str[i] == '0') i++;
-    else {
-        if (!in_range(str[i], '1', '9'))
-            return fail(Json(JSON_PARSE_INVALID_VALUE));  //检查至少有一个digit
-        for (i++; in_range(str[i], '0', '9'); i++);  //跳过所有digit
-    }
-
-    if (str[i] != '.' && str[i] != 'e' && str[i] != 'E' && (i - start) <=
-            static_cast<size_t>(std::numeric_limits<int>::digits10)) {
-        // std::numeric_limits<int>::digits10表示用10进制表示int的最大值需要的位数
-        // 将该字符串转化为int
-        return std::atoi(str.c_str() + start);
+    MYJSON_TIMER(number_ns);
+    const char* p = str + i;
+    Number n;
+    State s = scan_number(p, str + length, n);
+    if (s != JSON_PARSE_OK)
+        return fail(Json(s));
+    i = p - str;
+    switch (n.kind) {
+        case Number::INT:  return Json(n.i);
+        case Number::UINT: return Json(n.u);
+        default:           return Json(n.d);
     }
-
-    // Decimal部分，从这开始使用double
-    if (str[i] == '.') {
-        i++;
-        if (!in_range(str[i], '0', '9'))  //检查至少有一个digit
-            return fail(Json(JSON_PARSE_INVALID_VALUE));
-        for (i++; in_range(str[i], '0', '9'); i++);
-    }
-
-    // Exponent部分
-    if (str[i] == 'e' || str[i] == 'E') {
-        i++;
-        if (str[i] == '+' || str[i] == '-') i++;    //跳过正负号
-        if (!in_range(str[i], '0', '9'))
-            return fail(Json(JSON_PARSE_INVALID_VALUE));
-        for (i++; in_range(str[i], '0', '9'); i++);
-    }
-    return std::strtod(str.c_str() + start, nullptr);
 }
 
-
 // 在leptjson中这个方法是手动计算的。也可以采用标准库的strtol，但是这个计算足够简单，无法一眼判断是否有替换的必要。
 bool JsonParser::parse_hex4(unsigned int& u) {
+    u = 0;
     for (size_t j = 0; j < 4; j++) {
-        char ch = str[i++];
+        char ch = next();
         u <<= 4;
         if      (in_range(ch, '0', '9')) u |= ch - '0';
         else if (in_range(ch, 'A', 'F')) u |= ch - 'A' + 10;
@@ -272,130 +628,244 @@ bool JsonParser::parse_hex4(unsigned int& u) {
     return true;
 }
 
-void JsonParser::encode_utf8(unsigned int u, string& out) {
+/*
+    解码字符串的输出方式：追加到std::string，或者在输入中原地写回。
+    原地解码时转义序列总是比解码结果长，所以写入位置不会超过读取位置。
+*/
+struct StringSink {
+    string& out;
+    void append(const char* p, size_t n) { out.append(p, n); }
+    void put(char ch) { out += ch; }
+};
+
+struct InsituSink {
+    char* w;
+    void append(const char* p, size_t n) {
+        if (w != p) std::memmove(w, p, n);
+        w += n;
+    }
+    void put(char ch) { *w++ = ch; }
+};
+
+// 只检查不输出
+struct NullSink {
+    void append(const char*, size_t) {}
+    void put(char) {}
+};
+
+template <typename Out>
+static void put_utf8(unsigned int u, Out& out) {
     if (u <= 0x7F) {
-        out += static_cast<char>(u);
+        out.put(static_cast<char>(u));
     } else if (u <= 0x7FF) {
-        out += static_cast<char>(0xC0 | (u >> 6));
-        out += static_cast<char>(0x80 | (u & 0x3F));
+        out.put(static_cast<char>(0xC0 | (u >> 6)));
+        out.put(static_cast<char>(0x80 | (u & 0x3F)));
     } else if (u <= 0xFFFF) {
-        out += static_cast<char>(0xE0 | (u >> 12));
-        out += static_cast<char>(0x80 | ((u >> 6) & 0x3F));
-        out += static_cast<char>(0x80 | (u & 0x3F));
+        out.put(static_cast<char>(0xE0 | (u >> 12)));
+        out.put(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+        out.put(static_cast<char>(0x80 | (u & 0x3F)));
     } else {
         assert(u <= 0x10FFFF);
-        out += static_cast<char>(0xF0 | (u >> 18));
-        out += static_cast<char>(0x80 | ((u >> 12) & 0x3F));
-        out += static_cast<char>(0x80 | ((u >> 6) & 0x3F));
-        out += static_cast<char>(0x80 | (u & 0x3F));
+        out.put(static_cast<char>(0xF0 | (u >> 18)));
+        out.put(static_cast<char>(0x80 | ((u >> 12) & 0x3F)));
+        out.put(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+        out.put(static_cast<char>(0x80 | (u & 0x3F)));
     }
 }
 
-// 解析字符串
-string JsonParser::parse_string() {
-    string out;
-    while (i < str.size()) {
+void JsonParser::encode_utf8(unsigned int u, string& out) {
+    StringSink sink{out};
+    put_utf8(u, sink);
+}
+
+// 检查[i, end)中的UTF-8，出错时i指向不合法的序列
+bool JsonParser::check_utf8(const char* end) {
+    // 大多数字符串很短并且全是ASCII，先每次8字节检查最高位
+    const char* p = str + i;
+    uint64_t high = 0;
+    for (; end - p >= 8; p += 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        high |= w;
+    }
+    while (p != end)
+        high |= static_cast<unsigned char>(*p++);
+    if (!(high & 0x8080808080808080ull))
+        return true;
+    const char* bad = simd::validate_utf8(str + i, end);
+    if (bad == end)
+        return true;
+    i = bad - str;
+    return fail(false, JSON_PARSE_INVALID_UTF8);
+}
+
+// 解析字符串的内容，开头的引号已经读过，结束时i指向右引号之后
+template <typename Out>
+bool JsonParser::parse_string_raw(Out& out) {
+    const char* end = str + length;
+    bool escaped = false;
+    while (true) {
+        // 用SIMD找到下一个引号、反斜杠或控制字符，中间的普通字符整段拷贝
+        const char* p = simd::scan_string(str + i, end);
+        if (strict && !check_utf8(p))
+            return false;
+        out.append(str + i, p - (str + i));
+        i = p - str;
+        if (p == end)   //字符串没有右引号结尾就意外结束了
+            return fail(false, JSON_PARSE_MISS_QUOTATION_MARK);
         char ch = str[i++];
-        switch (ch) {
-            case '"':
-                return out;
-            case '\\':
-                switch (str[i++]) {
-                    case '\\':  out += '\\'; break;
-                    case 'b':   out += '\b'; break;
-                    case 'f':   out += '\f'; break;
-                    case 'n':   out += '\n'; break;
-                    case 'r':   out += '\r'; break;
-                    case 't':   out += '\t'; break;
-                    case '"':   out += '\"'; break;
-                    case '/':   out += '/';  break;
-                    case 'u':   //unicode字符
-                        // 一口气读取4字节，把这个Unicode字符读取完
-                        unsigned int u, u2;
-                        if (!parse_hex4(u))  // 返回一个（错误码）不可能的值，直接返回
-                            return fail("");
-                        /*
-                            utf-8的字符长度可以是1，2，3。
-                            Json可以使用代理对（surrogate pair），用两个16位的字符来表达一个Unicode码点
-                            如果第一个码点是U+D800至U+DBFF，说明这是高代理项，后面一定伴随一个U+DC00至U+DFFF的低代理项
-                            这里需要将代理对转换为Unicode码点
-                        */
-                        if (u >= 0xD800 && u <= 0xDBFF) {
-                            if (str[i++] != '\\')
-                                return fail("");
-                            if (str[i++] != 'u')
-                                return fail("");
-                            if (!parse_hex4(u2))
-                                return fail("");
-                            if (u2 < 0xDC00 || u2 > 0xDFFF)
-                                return fail("");
-                            u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
-                        }
-                        encode_utf8(u, out);
-                        break;
-                    default:
-                        return fail("");
+        if (ch == '"') {
+            MYJSON_STAT(if (escaped) stats->escaped_strings++);
+            return true;
+        }
+        if (ch != '\\')
+            return fail(false, JSON_PARSE_INVALID_STRING_CHAR);
+        escaped = true;
+        switch (next()) {
+            case '\\':  out.put('\\'); break;
+            case 'b':   out.put('\b'); break;
+            case 'f':   out.put('\f'); break;
+            case 'n':   out.put('\n'); break;
+            case 'r':   out.put('\r'); break;
+            case 't':   out.put('\t'); break;
+            case '"':   out.put('\"'); break;
+            case '/':   out.put('/');  break;
+            case 'u':   //unicode字符
+                // 一口气读取4字节，把这个Unicode字符读取完
+                unsigned int u, u2;
+                if (!parse_hex4(u))
+                    return fail(false, JSON_PARSE_INVALID_UNICODE_HEX);
+                /*
+                    utf-8的字符长度可以是1，2，3。
+                    Json可以使用代理对（surrogate pair），用两个16位的字符来表达一个Unicode码点
+                    如果第一个码点是U+D800至U+DBFF，说明这是高代理项，后面一定伴随一个U+DC00至U+DFFF的低代理项
+                    这里需要将代理对转换为Unicode码点
+                */
+                if (u >= 0xD800 && u <= 0xDBFF) {
+                    if (next() != '\\')
+                        return fail(false, JSON_PARSE_INVALID_UNICODE_SURROGATE);
+                    if (next() != 'u')
+                        return fail(false, JSON_PARSE_INVALID_UNICODE_SURROGATE);
+                    if (!parse_hex4(u2))
+                        return fail(false, JSON_PARSE_INVALID_UNICODE_HEX);
+                    if (u2 < 0xDC00 || u2 > 0xDFFF)
+                        return fail(false, JSON_PARSE_INVALID_UNICODE_SURROGATE);
+                    u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
                 }
+                put_utf8(u, out);
                 break;
-            case '\0':  //字符串没有右引号结尾就意外结束了
-                return fail("");
             default:
-                if ((unsigned char)ch < 0x20)
-                    return fail("");
-                out += ch;  //ASCII字符，直接添加
+                return fail(false, JSON_PARSE_INVALID_STRING_ESCAPE);
         }
     }
-    return fail("");
 }
 
-// 解析数组
-Json JsonParser::parse_array() {
-    Json::array a;
-    char ch = get_next_token();
-    if (ch == ']') return a;
-    while (true) {
-        i--;
-        a.push_back(parse_json());
-        if (a.rbegin()->state != JSON_PARSE_OK)
-            return *a.rbegin();
-        ch = get_next_token();
-        if (ch == ']') break;
-        else if (ch != ',') return Json(JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET);
-        ch = get_next_token();
-    }
-    return a;
+// 解析字符串
+string JsonParser::parse_string() {
+    string out;
+    StringSink sink{out};
+    if (!parse_string_raw(sink))
+        return "";
+    return out;
 }
 
-// 解析对象
-Json JsonParser::parse_object() {
-    Json::object o;
-    char ch = get_next_token();
-    // printf("%c\n", ch);
-    if (ch == '}') return o;
-    while (true) {
-        if (ch != '"') return fail(Json(JSON_PARSE_MISS_KEY));
-        string key = parse_string();
-        // printf("%s\n", key.c_str());
-        if (failed) return fail();
-        ch = get_next_token();
-        if (ch != ':') return fail(Json(JSON_PARSE_MISS_COLON));
-        o[move(key)] = parse_json();
-        if (failed) return fail();
-        ch = get_next_token();
-        if (ch == '}') break;
-        if (ch != ',') return fail(Json(JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET));
-        ch = get_next_token();
+// 解析字符串，不含转义时直接引用输入；否则原地解码（insitu不为空时），或者解码到buffer中，
+// 此时结果只在下一次解析字符串之前有效
+StringView JsonParser::parse_string_ref() {
+    size_t start = i;
+    const char* p = simd::scan_string(str + i, str + length);
+    if (p != str + length && *p == '"') {
+        if (strict && !check_utf8(p))
+            return StringView();
+        i = p - str + 1;
+        return StringView(str + start, p - (str + start));
+    }
+    if (discard) {
+        NullSink sink;
+        parse_string_raw(sink);
+        return StringView();
     }
-    return o;
+    if (insitu) {
+        InsituSink sink{insitu + start};
+        if (!parse_string_raw(sink))
+            return StringView();
+        return StringView(insitu + start, sink.w - (insitu + start));
+    }
+    buffer.clear();
+    StringSink sink{buffer};
+    if (!parse_string_raw(sink))
+        return StringView();
+    return StringView(buffer);
+}
+
+// 借用模式下解析字符串，解码到buffer中的字符串需要复制到arena
+StringView JsonParser::parse_string_view() {
+    StringView v = parse_string_ref();
+    if (failed || buffer.empty() || v.data() != buffer.data())
+        return v;
+    char* copy = static_cast<char*>(arena->allocate(v.size(), 1));
+    std::memcpy(copy, v.data(), v.size());
+    return StringView(copy, v.size());
 }
 
 Json Json::parse(const string& in) {
     JsonParser parser(in);
-    Json res = parser.parse_json();
+    return parser.parse();
+}
 
-    if (parser.get_index() != in.size() || parser.failed)
-        return Json(res.state);
-    return res;
+Json Json::parse(const char* in, size_t len) {
+    JsonParser parser(in, len);
+    return parser.parse();
+}
+
+State Json::validate(const char* in, size_t len, size_t* error_offset) {
+    JsonParser parser(in, len);
+    State s = parser.validate();
+    if (error_offset)
+        *error_offset = s == JSON_PARSE_OK ? len : parser.get_index();
+    return s;
+}
+
+/*
+    Document
+*/
+
+const Json& Document::parse(JsonParser& parser) {
+    parser.intern_keys(pool);
+    parser.collect_stats(stats);
+    parser.strict_utf8(strict);
+    parser.limit_depth(max_depth);
+    root_ = parser.parse();
+    return root_;
+}
+
+const Json& Document::parse(const string& in) {
+    return parse(in.data(), in.size());
+}
+
+const Json& Document::parse(const char* in, size_t len) {
+    reset();
+    JsonParser parser(in, len, &arena);
+    return parse(parser);
+}
+
+const Json& Document::parse_view(const char* in, size_t len) {
+    reset();
+    JsonParser parser(in, len, &arena);
+    parser.borrow_strings();
+    return parse(parser);
+}
+
+const Json& Document::parse_insitu(char* in, size_t len) {
+    reset();
+    JsonParser parser(in, len, &arena);
+    parser.borrow_strings(in);
+    return parse(parser);
+}
+
+void Document::reset() {
+    root_ = Json();
+    arena.reset();
 }
 
 }  // namespace myjson
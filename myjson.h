@@ -1,9 +1,14 @@
 #pragma once
 #include <string>
 #include <vector>
-#include <map>
 #include <memory>
 #include <cassert>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include "arena.h"
+#include "flatmap.h"
 
 using std::string;
 // using std::shared_ptr;
@@ -23,14 +28,77 @@ enum State {
     JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
     JSON_PARSE_MISS_KEY,
     JSON_PARSE_MISS_COLON,
-    JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+    JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+    JSON_PARSE_TERMINATED,                  // SAX的handler要求停止解析
+    JSON_PARSE_IO_ERROR,                    // 文件无法打开或者读取
+    JSON_PARSE_INVALID_PATH,                // 路径表达式的语法错误
+    JSON_PARSE_PATH_NOT_FOUND,              // 路径指向的值不存在
+    JSON_PARSE_INVALID_CBOR,                // CBOR数据格式错误，或者含有JSON无法表示的值
+    JSON_PARSE_TYPE_MISMATCH,               // 值的类型和绑定的字段不符
+    JSON_PARSE_INVALID_PATCH,               // JSON Patch的操作格式错误
+    JSON_PARSE_TEST_FAILED,                 // JSON Patch的test操作没有通过
+    JSON_PARSE_INVALID_UTF8,                // 严格模式下字符串中有不合法的UTF-8
+    JSON_PARSE_TOO_DEEP,                    // 数组和对象的嵌套超过了允许的最大深度
+    JSON_PARSE_INVALID_SCHEMA,              // JSON Schema本身不合法或者用到了不支持的关键字
+    JSON_PARSE_SCHEMA_MISMATCH              // 值不符合JSON Schema
 };
 
-class JsonValue;
+class Json;
+class JsonParser;
+class InternPool;
+struct ParseStats;
+
+/*
+    StringView：指向一段不属于自己的字符，相当于C++17的std::string_view。
+    借用模式解析出的字符串通过它直接访问输入中的内容。
+*/
+class StringView {
+public:
+    StringView() : ptr(""), len(0) {}
+    StringView(const char* s, size_t n) : ptr(s), len(n) {}
+    StringView(const char* s) : ptr(s), len(std::strlen(s)) {}
+    StringView(const string& s) : ptr(s.data()), len(s.size()) {}
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    const char* begin() const { return ptr; }
+    const char* end() const { return ptr + len; }
+    char operator[](size_t i) const { return ptr[i]; }
+    string to_string() const { return string(ptr, len); }
+
+    friend bool operator==(StringView a, StringView b) {
+        return a.len == b.len && std::memcmp(a.ptr, b.ptr, a.len) == 0;
+    }
+    friend bool operator!=(StringView a, StringView b) { return !(a == b); }
+    friend bool operator<(StringView a, StringView b) {
+        int r = std::memcmp(a.ptr, b.ptr, a.len < b.len ? a.len : b.len);
+        return r != 0 ? r < 0 : a.len < b.len;
+    }
+
+private:
+    const char* ptr;
+    size_t len;
+};
+
+/*
+    字符串、数组、对象这些不定长的值放在堆上（或Arena中）的节点里，节点只保存引用计数和缓存的hash，
+    具体的值由派生类Value<t, T>保存。节点没有虚函数，类型由持有它的Json记录。
+*/
+class JsonValue {
+    friend class Json;
+    friend class Comparator;
+
+   protected:
+    mutable std::atomic<long> refs{1};
+    mutable std::atomic<uint64_t> hash_code{0};   // 0表示还没有计算，修改节点时清除
+};
 
 class Json {
-   private:
-    std::shared_ptr<JsonValue> v_ptr;
+    friend class JsonParser;
+    friend class Serializer;
+    friend class CborEncoder;
+    friend class Comparator;
 
    public:
     enum Type {
@@ -42,49 +110,160 @@ class Json {
         JSON_OBJECT
     };
 
+    // 内部的类型标记，前几项和Type一致，数字和字符串按照存储方式细分
+    enum Tag : uint8_t {
+        TAG_NULL = JSON_NULL,
+        TAG_BOOL = JSON_BOOL,
+        TAG_INT = JSON_NUMBER,
+        TAG_STRING = JSON_STRING,
+        TAG_ARRAY = JSON_ARRAY,
+        TAG_OBJECT = JSON_OBJECT,
+        TAG_DOUBLE,
+        TAG_UINT,           // 超过int64范围的无符号整数
+        TAG_STRING_VIEW     // 借用输入缓冲区的字符串
+    };
+
+   private:
+    // null、bool、int、double直接存放在Json中，其余类型指向节点
+    union {
+        bool b;
+        int64_t i;
+        uint64_t ui;
+        double d;
+        JsonValue* p;
+    } u;
+    uint8_t tag;
+    bool owns;  // 是否持有节点的引用计数。Arena中的节点不计数
+
+    // 供JsonParser使用，直接用已经构造好的节点创建Json
+    Json(JsonValue* node, uint8_t tag, bool owns) : tag(tag), owns(owns) { u.p = node; }
+
+    void release();
+    // 是否是节点唯一的持有者，可以直接修改
+    bool unique() const;
+
+   public:
     State state = JSON_PARSE_OK;
 
     // 给数组和对象类型起别名
-    typedef std::vector<Json> array;
-    typedef std::map<string, Json> object;
+    // 分配器默认使用堆内存，在Document中解析时则从Arena中分配
+    typedef std::vector<Json, JsonAllocator<Json>> array;
+    typedef FlatMap<Json> object;
 
     // 构造函数
-    Json() noexcept;
+    Json() noexcept : tag(TAG_NULL), owns(false) { u.p = nullptr; }
     // Json(std::nullptr_t);
-    Json(State s);              // 用State构造
-    Json(bool value);           // BOOL
-    Json(int value);            // int
-    Json(double value);         // double
+    Json(State s) : tag(TAG_NULL), owns(false), state(s) { u.p = nullptr; }     // 用State构造
+    Json(bool value) : tag(TAG_BOOL), owns(false) { u.p = nullptr; u.b = value; }  // BOOL
+    Json(int value) : tag(TAG_INT), owns(false) { u.i = value; }                   // int
+    Json(int64_t value) : tag(TAG_INT), owns(false) { u.i = value; }               // int64
+    Json(uint64_t value) : tag(value > INT64_MAX ? TAG_UINT : TAG_INT), owns(false) { u.ui = value; }  // uint64
+    Json(double value) : tag(TAG_DOUBLE), owns(false) { u.d = value; }             // double
     Json(const string& value);  // std::string
     Json(string&& value);       // move string
     Json(const char* value);    // c-style string
     Json(const array& value);   // std::vector
     Json(array&& value);        // move array
-    Json(const object& value);  // std::map
-    Json(object&& value);       // move map
+    Json(const object& value);  // FlatMap
+    Json(object&& value);       // move FlatMap
 
+    // 拷贝只增加节点的引用计数
+    Json(const Json& other) noexcept : u(other.u), tag(other.tag), owns(other.owns), state(other.state) {
+        if (owns) u.p->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    Json(Json&& other) noexcept : u(other.u), tag(other.tag), owns(other.owns), state(other.state) {
+        other.tag = TAG_NULL;
+        other.owns = false;
+    }
+    Json& operator=(const Json& other) noexcept {
+        Json tmp(other);
+        return *this = std::move(tmp);
+    }
+    Json& operator=(Json&& other) noexcept {
+        if (this != &other) {
+            if (owns) release();
+            u = other.u;
+            tag = other.tag;
+            owns = other.owns;
+            state = other.state;
+            other.tag = TAG_NULL;
+            other.owns = false;
+        }
+        return *this;
+    }
+    ~Json() {
+        if (owns) release();
+    }
 
     // 类型
-    Type type() const;
+    Type type() const {
+        return tag <= TAG_OBJECT ? static_cast<Type>(tag) : tag == TAG_STRING_VIEW ? JSON_STRING : JSON_NUMBER;
+    }
     bool is_null()      const { return type() == JSON_NULL; }
     bool is_bool()      const { return type() == JSON_BOOL; }
     bool is_number()    const { return type() == JSON_NUMBER; }
+    bool is_integer()   const { return tag == TAG_INT || tag == TAG_UINT; }
     bool is_string()    const { return type() == JSON_STRING; }
     bool is_array()     const { return type() == JSON_ARRAY; }
     bool is_obejct()    const { return type() == JSON_OBJECT; }
 
-    // 获得值
-    bool bool_value() const;
-    double number_value() const;
-    int int_value() const;
+    // 获得值，标量直接从Json中读取
+    bool bool_value() const { return tag == TAG_BOOL && u.b; }
+    double number_value() const {
+        return tag == TAG_DOUBLE ? u.d : tag == TAG_INT ? static_cast<double>(u.i)
+             : tag == TAG_UINT ? static_cast<double>(u.ui) : 0;
+    }
+    // 使用static_cast安全转型
+    int int_value() const { return static_cast<int>(int64_value()); }
+    int64_t int64_value() const {
+        return tag == TAG_INT || tag == TAG_UINT ? u.i : tag == TAG_DOUBLE ? static_cast<int64_t>(u.d) : 0;
+    }
+    uint64_t uint64_value() const {
+        return tag == TAG_INT || tag == TAG_UINT ? u.ui : tag == TAG_DOUBLE ? static_cast<uint64_t>(u.d) : 0;
+    }
+    // 借用模式解析出的字符串第一次调用string_value()时会复制一份，string_view()则总是不复制
     const string& string_value() const;
+    StringView string_view() const;
     const array & array_value() const;
     const object & object_value() const;
 
     // 重载[]符号，通过index得到数组元素，或者string得到object元素
     const Json& operator[] (size_t i) const;
     const Json& operator[] (const string& key) const;
+    // 用InternPool中的Key查找，相同的key只需要比较指针
+    const Json& get(const Key& key) const;
 
+    /*
+        修改：节点在多个Json之间共享，修改前如果节点不只被这个Json持有（或者在Arena中），
+        就先在堆上复制一份，新节点中的元素仍然和原来共享（写时复制）。
+        所以修改一个深层的值只会复制从根到它的路径，其余的子树不会被复制。
+        Document中解析出的Json修改之后，没有被复制的子树仍然在Document的Arena中。
+    */
+    // 可以修改的数组或对象，类型不符时返回nullptr。返回的指针在这个Json下一次修改前有效
+    array* mutable_array();
+    object* mutable_object();
+    // 可以修改的子节点，不存在时返回nullptr，用于逐层修改深层的值
+    Json* edit(size_t i);
+    Json* edit(const string& key);
+    // 对象：key已经存在时替换它的值（位置不变），否则添加到最后。null会先变成空对象
+    bool set(const string& key, Json value);
+    // 删除key，返回是否存在
+    bool erase(const string& key);
+    // 数组：替换、插入（i可以等于size）、删除第i个元素，以及添加到最后。null会先变成空数组
+    bool set(size_t i, Json value);
+    bool insert(size_t i, Json value);
+    bool erase(size_t i);
+    bool push_back(Json value);
+
+    /*
+        比较和hash，定义在compare.cpp中。
+        数字按照数学上的值比较，1和1.0相等；对象的成员不考虑顺序；两个Json共享同一个节点时直接相等。
+        排序先按照类型（null < bool < number < string < array < object），
+        同类型的数组按元素、对象按照key排序后的成员逐个比较。
+        字符串、数组、对象的hash在第一次计算后缓存在节点中，之后是O(1)的，修改时自动失效。
+        通过edit()得到的指针修改子节点之前，不要对这个Json求hash，否则缓存的hash不会更新。
+    */
+    uint64_t hash() const;
     bool operator== (const Json &rhs) const;
     bool operator<  (const Json &rhs) const;
     bool operator!= (const Json &rhs) const { return !(*this == rhs); }
@@ -93,44 +272,156 @@ class Json {
     bool operator>= (const Json &rhs) const { return !(*this < rhs); }
 
     static Json parse(const std::string& in);
-};
+    static Json parse(const char* in, size_t len);
+    // 通过mmap读取整个文件并解析，定义在file.cpp中
+    static Json parse_file(const std::string& path);
+    // 根是很大的数组或对象时，先建立结构索引，再用threads个线程并行解析根的元素，定义在index.cpp中。
+    // threads为0时使用std::thread::hardware_concurrency()，输入较小时直接串行解析
+    static Json parse_parallel(const char* in, size_t len, unsigned threads = 0);
+    // 只检查in是否是合法的JSON（包括字符串中的UTF-8），不构造Json也不分配内存。
+    // 返回和解析时相同的错误码，error_offset不为空时得到出错的位置
+    static State validate(const char* in, size_t len, size_t* error_offset = nullptr);
+    static State validate(const std::string& in, size_t* error_offset = nullptr) {
+        return validate(in.data(), in.size(), error_offset);
+    }
 
-class JsonValue {
-    friend class Json;
+    // 序列化，结果追加到out的末尾。indent为0时输出紧凑格式，大于0时每层缩进indent个空格
+    // sort_keys为true时object按照key的顺序输出，同样的Json总是得到同样的结果；为false时按照成员原来的顺序输出
+    void dump(string& out, int indent = 0, bool sort_keys = true) const;
+    string dump(int indent = 0, bool sort_keys = true) const;
+};
 
-   protected:
-    virtual Json::Type type() const = 0;
-    virtual bool bool_value() const;
-    virtual double number_value() const;
-    virtual int int_value() const;
-    virtual const string& string_value() const;
-    virtual const Json::array& array_value() const;
-    virtual const Json::object& object_value() const;
-    virtual const Json& operator[] (size_t i) const;
-    virtual const Json& operator[] (const string& key) const;
+static_assert(sizeof(Json) == 16, "Json should stay 16 bytes");
 
-};
+// 默认允许的数组和对象的最大嵌套深度
+const size_t default_max_depth = 1024;
 
 class JsonParser final {
 private:
-    const string& str;
+    // 还没有结束的数组或对象，base是它的元素在scratch（对象是members）中的开始位置
+    struct Frame {
+        bool object;
+        size_t base;
+    };
+
+    const char* str;
+    size_t length;
     size_t i = 0;
+    Arena* arena;               // 不为空时，所有节点都在arena中分配
+    bool borrow = false;        // 字符串是否借用输入而不复制
+    char* insitu = nullptr;     // 不为空时，含转义的字符串在这里原地解码
+    bool duplicates = false;    // 是否保留对象中重复的key
+    bool strict = false;        // 是否检查字符串中的UTF-8
+    bool discard = false;       // 只检查语法，含转义的字符串不解码
+    std::vector<Frame> stack;   // 正在解析的容器，最内层在最后
+    std::vector<Json> scratch;  // 解析数组时暂存元素，嵌套的数组共用
+    std::vector<Json::object::value_type> members;  // 解析对象时暂存成员，嵌套的对象共用
+    InternPool* pool = nullptr;                     // 不为空时，长key从这里取得规范副本
+    std::vector<Key> key_cache;                     // 最近从pool取得的key，命中时不需要加锁
+    ParseStats* stats = nullptr;                    // 不为空时记录统计信息
+    size_t max_depth = default_max_depth;           // 允许的最大嵌套深度
+    string buffer;              // 借用模式下解码含转义字符串的临时空间
+
+    template <typename T, typename V>
+    Json make_value(V&& v);
+    Key make_key(StringView s);
+    template <typename Out>
+    bool parse_string_raw(Out& out);
+    bool check_utf8(const char* end);
+    bool read_key(char& ch);
+    Json close_container();
+    Json unwind(size_t bottom, State s);
+    template <typename Handler>
+    bool sax_value(Handler& handler);
+    template <typename Handler>
+    bool sax_key(Handler& handler, char& ch);
+    // 出错时丢弃这次解析中未结束的容器
+    bool drop_frames(size_t bottom) {
+        stack.resize(bottom);
+        return false;
+    }
+    bool drop_frames(size_t bottom, State s) {
+        stack.resize(bottom);
+        return fail(false, s);
+    }
+
+    // handler返回false时停止解析
+    bool emit(bool ok) { return ok || fail(false, JSON_PARSE_TERMINATED); }
 
 
+    // 越过输入末尾时返回'\0'，并且不再前进
+    char next() { return i < length ? str[i++] : '\0'; }
+
 public:
     bool failed = false;
-    JsonParser(const std::string& in) : str(in){};
+    State error = JSON_PARSE_OK;    // 字符串解析失败时记录具体的错误码
+    JsonParser(const std::string& in, Arena* arena = nullptr) : str(in.data()), length(in.size()), arena(arena) {};
+    JsonParser(const char* in, size_t len, Arena* arena = nullptr) : str(in), length(len), arena(arena) {};
+
+    // 换一个新的输入重新开始解析，保留已经分配的内部缓冲区，用于连续解析很多小的输入
+    void reset(const char* in, size_t len) {
+        str = in;
+        length = len;
+        i = 0;
+        failed = false;
+        error = JSON_PARSE_OK;
+    }
+
+    // 借用模式，必须配合arena使用。不含转义的字符串直接指向输入；
+    // writable不为空时（必须和输入是同一块内存），含转义的字符串在其中原地解码，否则解码后复制到arena
+    void borrow_strings(char* writable = nullptr) {
+        assert(arena && (!writable || writable == str));
+        borrow = true;
+        insitu = writable;
+    }
+
+    // 默认重复的key只保留最后一次出现的值（位置在第一次出现处），打开后所有成员都按原来的顺序保留
+    void keep_duplicate_keys(bool keep = true) { duplicates = keep; }
+
+    // 严格模式：字符串中不合法的UTF-8（过长编码、代理项、超过U+10FFFF等）返回JSON_PARSE_INVALID_UTF8。
+    // 默认不检查，非ASCII的字节原样复制
+    void strict_utf8(bool check = true) { strict = check; }
+
+    // 数组和对象的嵌套超过max层时返回JSON_PARSE_TOO_DEEP。解析本身不递归，
+    // 限制是为了Json的析构和序列化（逐层递归）不会用尽线程的栈
+    void limit_depth(size_t max) { max_depth = max; }
+
+    // 对象的key使用pool中的规范副本，pool必须比解析出的Json活得更久。
+    // 缓存的key在这里丢弃，换用另一个pool（即使地址相同）之后不会再拿到旧pool中的key
+    void intern_keys(InternPool* keys) {
+        pool = keys;
+        key_cache.clear();
+    }
+    // 之后的解析把统计信息累加到s中，传入nullptr关闭，见stats.h
+    void collect_stats(ParseStats* s) { stats = s; }
+
     Json parse();
+    // SAX风格的解析，不构造Json，而是把解析到的值依次交给handler，定义在reader.h中
+    template <typename Handler>
+    State parse(Handler& handler);
+
     void parse_whitespace();
     char get_next_token();
+    // 跳过空白，返回下一个token的第一个字符但不读取它，输入结束时返回'\0'
+    char peek_token() {
+        parse_whitespace();
+        return i < length ? str[i] : '\0';
+    }
+    // 检查并跳过一个完整的值，不构造Json
+    bool skip_value();
+    // 严格模式下检查整个输入而不构造Json，含转义的字符串不解码，见Json::validate
+    State validate();
+    // 解析一个值，不要求后面没有其他内容
     Json parse_json();
-    Json parse_literal(const string& expected, Json res);
+    bool match_literal(const char* expected);
     Json parse_number();
     bool parse_hex4(unsigned int & u);
     string parse_string();
-    Json parse_array();
-    Json parse_object();
-    int get_index() const { return i; }
+    StringView parse_string_ref();
+    StringView parse_string_view();
+    size_t get_index() const { return i; }
+    // 回到之前用get_index()得到的位置
+    void seek(size_t pos) { i = pos < length ? pos : length; }
     void encode_utf8(unsigned int u, string& out);
 
     template <typename T>
@@ -139,9 +430,73 @@ public:
         return ret;
     }
 
+    template <typename T>
+    T fail(const T ret, State s) {
+        error = s;
+        return fail(ret);
+    }
+
     Json fail() {
         return fail(Json());
     }
 };
 
+/*
+    Document：在Arena上解析的Json文档。
+    一次解析产生的节点、数组、对象都分配在Document持有的大块内存中，
+    Json之间也不再维护引用计数。这些Json只在Document存活、并且没有再次parse()或reset()时有效。
+    Document可以反复使用，reset()后已申请的内存块会被下一次解析复用。
+*/
+class Document {
+public:
+    explicit Document(size_t block_size = 64 * 1024) : arena(block_size) {}
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    const Json& parse(const string& in);
+    const Json& parse(const char* in, size_t len);
+
+    // 借用模式：不含转义的字符串和in共享内存而不复制。
+    // in必须保持有效并且不被修改，直到Document下一次parse()、reset()或者析构。
+    // object的key仍然会复制：不超过14字节的key本来就存放在Key内部；更长的key复制到arena中，
+    // 因为查找和对象的哈希索引要用到和字符放在一起的、预先算好的哈希值，16字节的Key放不下指针、长度和哈希值
+    const Json& parse_view(const char* in, size_t len);
+    // 原地模式：和parse_view相同，含转义的字符串也直接在in中解码，in的内容会被改写
+    const Json& parse_insitu(char* in, size_t len);
+
+    const Json& root() const { return root_; }
+    State state() const { return root_.state; }
+
+    // 之后的解析使用pool中的key，同一个pool可以被多个Document共用
+    void intern_keys(InternPool* keys) { pool = keys; }
+    // 之后的解析把统计信息累加到s中
+    void collect_stats(ParseStats* s) { stats = s; }
+    // 之后的解析检查字符串中的UTF-8，见JsonParser::strict_utf8
+    void strict_utf8(bool check = true) { strict = check; }
+    // 之后的解析允许的最大嵌套深度，见JsonParser::limit_depth
+    void limit_depth(size_t max) { max_depth = max; }
+
+    void reset();
+    size_t memory_used() const { return arena.used(); }
+    size_t memory_reserved() const { return arena.reserved(); }
+
+private:
+    const Json& parse(JsonParser& parser);
+
+    Arena arena;
+    InternPool* pool = nullptr;
+    ParseStats* stats = nullptr;
+    bool strict = false;
+    size_t max_depth = default_max_depth;
+    Json root_;
+};
+
 }  // namespace myjson
+
+namespace std {
+template <>
+struct hash<myjson::Json> {
+    size_t operator()(const myjson::Json& json) const { return static_cast<size_t>(json.hash()); }
+};
+}  // namespace std
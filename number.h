@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "myjson.h"
+
+namespace myjson {
+
+// 一次扫描得到的数字：不带小数和指数、并且放得下64位整数时保存为整数，否则为double
+struct Number {
+    enum Kind { INT, UINT, DOUBLE } kind;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+};
+
+/*
+    解析[p, end)开头的JSON数字，成功时p移动到数字之后。
+    number = [ "-" ] int [ frac ] [ exp ]
+    int = "0" / digit1-9 *digit
+    frac = "." 1*digit
+    exp = ("e" / "E") ["-" / "+"] 1*digit
+    校验语法的同时累加尾数，整数直接得到int64/uint64；
+    浮点数先尝试Clinger快速路径，再用Eisel-Lemire算法，极少数无法确定舍入的情况才回退到strtod。
+    转换与locale无关。
+*/
+State scan_number(const char*& p, const char* end, Number& out);
+
+// 把十进制的 w * 10^q 转换为最接近的double，无法确定时返回false
+bool decimal_to_double(uint64_t w, int64_t q, bool negative, double& out);
+
+}  // namespace myjson
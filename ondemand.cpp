@@ -0,0 +1,156 @@
+#include "ondemand.h"
+
+namespace myjson {
+
+Path::Path(const string& expr) {
+    ok = expr.empty() || expr[0] == '/' ? parse_pointer(expr) : parse_dotted(expr);
+    if (!ok)
+        segments.clear();
+}
+
+void Path::add(string key, bool index_only) {
+    Segment seg{std::move(key), 0, false};
+    const string& k = seg.key;
+    if (!k.empty() && k.size() <= 19 && (k[0] != '0' || k.size() == 1) &&
+        k.find_first_not_of("0123456789") == string::npos) {
+        seg.has_index = true;
+        for (char ch : k)
+            seg.index = seg.index * 10 + (ch - '0');
+    }
+    if (index_only && !seg.has_index)
+        ok = false;
+    segments.push_back(std::move(seg));
+}
+
+bool Path::parse_pointer(const string& expr) {
+    ok = true;
+    size_t p = 0;
+    while (p < expr.size()) {
+        // expr[p] == '/'
+        string key;
+        size_t q = p + 1;
+        for (; q < expr.size() && expr[q] != '/'; q++) {
+            if (expr[q] != '~') {
+                key += expr[q];
+            } else if (q + 1 < expr.size() && (expr[q + 1] == '0' || expr[q + 1] == '1')) {
+                key += expr[++q] == '0' ? '~' : '/';
+            } else {
+                return false;
+            }
+        }
+        add(std::move(key));
+        p = q;
+    }
+    return ok;
+}
+
+bool Path::parse_dotted(const string& expr) {
+    ok = true;
+    size_t p = 0;
+    while (p < expr.size()) {
+        if (expr[p] == '[') {
+            size_t q = expr.find(']', p);
+            if (q == string::npos)
+                return false;
+            add(expr.substr(p + 1, q - p - 1), true);
+            p = q + 1;
+            if (p < expr.size() && expr[p] == '.')
+                p++;
+        } else {
+            size_t q = expr.find_first_of(".[", p);
+            if (q == p)
+                return false;
+            if (q == string::npos)
+                q = expr.size();
+            add(expr.substr(p, q - p));
+            p = q;
+            if (p < expr.size() && expr[p] == '.' && ++p == expr.size())
+                return false;
+        }
+    }
+    return ok;
+}
+
+// 沿着路径前进，成功时parser停在目标值之前
+State Path::navigate(JsonParser& parser) const {
+    if (!ok)
+        return JSON_PARSE_INVALID_PATH;
+    for (const Segment& seg : segments) {
+        char ch = parser.get_next_token();
+        if (ch == '{') {
+            // 和Json::parse一样，重复的key使用最后一个，所以找到之后还要扫描完这个对象
+            bool found = false;
+            size_t value_begin = 0;
+            ch = parser.get_next_token();
+            while (ch != '}') {
+                if (ch != '"')
+                    return JSON_PARSE_MISS_KEY;
+                StringView key = parser.parse_string_ref();
+                if (parser.failed)
+                    return parser.error;
+                if (parser.get_next_token() != ':')
+                    return JSON_PARSE_MISS_COLON;
+                if (key == StringView(seg.key)) {
+                    parser.parse_whitespace();
+                    found = true;
+                    value_begin = parser.get_index();
+                }
+                if (!parser.skip_value())
+                    return parser.error;
+                ch = parser.get_next_token();
+                if (ch == ',') {
+                    ch = parser.get_next_token();
+                    if (ch != '"')
+                        return JSON_PARSE_MISS_KEY;
+                } else if (ch != '}') {
+                    return JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                }
+            }
+            if (!found)
+                return JSON_PARSE_PATH_NOT_FOUND;
+            parser.seek(value_begin);
+        } else if (ch == '[') {
+            if (!seg.has_index || parser.peek_token() == ']')
+                return JSON_PARSE_PATH_NOT_FOUND;
+            for (size_t k = 0; k < seg.index; k++) {
+                if (!parser.skip_value())
+                    return parser.error;
+                ch = parser.get_next_token();
+                if (ch == ']')
+                    return JSON_PARSE_PATH_NOT_FOUND;
+                if (ch != ',')
+                    return JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            }
+        } else if (ch == '\0') {
+            return JSON_PARSE_EXPECT_VALUE;
+        } else {
+            // 标量没有下一层
+            return JSON_PARSE_PATH_NOT_FOUND;
+        }
+    }
+    return JSON_PARSE_OK;
+}
+
+Json Path::extract(const char* data, size_t len) const {
+    JsonParser parser(data, len);
+    State s = navigate(parser);
+    if (s != JSON_PARSE_OK)
+        return Json(s);
+    Json value = parser.parse_json();
+    return parser.failed ? Json(value.state) : value;
+}
+
+State Path::locate(const char* data, size_t len, StringView& raw) const {
+    JsonParser parser(data, len);
+    State s = navigate(parser);
+    if (s != JSON_PARSE_OK)
+        return s;
+    parser.parse_whitespace();
+    size_t begin = parser.get_index();
+    if (!parser.skip_value())
+        return parser.error;
+    raw = StringView(data + begin, parser.get_index() - begin);
+    return JSON_PARSE_OK;
+}
+
+}  // namespace myjson
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    按需解析：Path先编译一次，之后可以在很多文档上重复使用。
+    提取时沿着路径扫描输入，路径之外的值只检查语法并跳过，不构造Json，
+    只有路径指向的值才会被解析。找到目标之后不再扫描剩下的输入，所以之后的语法错误不会被发现。
+    object中有重复的key时和Json::parse一样使用最后一个，因此路径经过的object要扫描到结尾。
+
+    支持两种写法：
+        JSON Pointer（RFC 6901）："/user/id"、"/items/0/name"，"~0"和"~1"分别表示'~'和'/'，空串表示整个文档
+        简单路径："user.id"、"items[0].name"
+    JSON Pointer中的数字既可以是数组的下标，也可以是object的key，取决于实际遇到的值。
+*/
+class Path {
+public:
+    explicit Path(const string& expr);
+
+    // 表达式是否合法，不合法时提取总是返回JSON_PARSE_INVALID_PATH
+    bool valid() const { return ok; }
+    size_t size() const { return segments.size(); }
+
+    // 解析路径指向的值，不存在时返回的Json的state为JSON_PARSE_PATH_NOT_FOUND
+    Json extract(const char* data, size_t len) const;
+    Json extract(const string& in) const { return extract(in.data(), in.size()); }
+
+    // 只找到路径指向的值在输入中的原始文本，不解析它（只检查语法）
+    State locate(const char* data, size_t len, StringView& raw) const;
+
+private:
+    struct Segment {
+        string key;
+        size_t index;
+        bool has_index;     // key是不含多余前导0的十进制数，可以作为数组的下标
+    };
+
+    bool parse_pointer(const string& expr);
+    bool parse_dotted(const string& expr);
+    void add(string key, bool index_only = false);
+    State navigate(JsonParser& parser) const;
+
+    std::vector<Segment> segments;
+    bool ok;
+};
+
+}  // namespace myjson
@@ -0,0 +1,136 @@
+#include "parallel.h"
+#include "simd.h"
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace myjson {
+
+ParallelNdjson::ParallelNdjson(unsigned threads, size_t chunk_size)
+    : nthreads(threads ? threads : std::thread::hardware_concurrency()), chunk_size(chunk_size ? chunk_size : 1) {
+    if (nthreads == 0)
+        nthreads = 1;
+}
+
+// 每个块从上一个块之后开始，在至少chunk_size字节之后的第一个换行处结束，所以每一行都完整地属于一个块
+std::vector<ParallelNdjson::Chunk> ParallelNdjson::split(const char* data, size_t len) const {
+    std::vector<Chunk> chunks;
+    const char* p = data;
+    const char* end = data + len;
+    while (p != end) {
+        const char* stop = end;
+        if (static_cast<size_t>(end - p) > chunk_size) {
+            const char* nl = static_cast<const char*>(std::memchr(p + chunk_size, '\n', end - p - chunk_size));
+            stop = nl ? nl + 1 : end;
+        }
+        chunks.push_back(Chunk{p, stop});
+        p = stop;
+    }
+    return chunks;
+}
+
+// 对一个块中的每个非空行调用f(行的开头, 解析结果)
+template <typename F>
+static void parse_chunk(const char* p, const char* end, JsonParser& parser, F f) {
+    while (p != end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* stop = nl ? nl : end;
+        if (simd::skip_whitespace(p, stop) != stop) {
+            parser.reset(p, stop - p);
+            Json record = parser.parse();
+            f(p, record);
+        }
+        p = nl ? nl + 1 : end;
+    }
+}
+
+/*
+    work-stealing：每个线程有一个双端队列，队列之间只在偷的时候竞争。
+    块很大，所以每个队列用一个mutex保护就足够了。
+*/
+namespace {
+
+struct WorkQueue {
+    std::mutex lock;
+    std::deque<size_t> tasks;
+
+    bool pop_front(size_t& task) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (tasks.empty())
+            return false;
+        task = tasks.front();
+        tasks.pop_front();
+        return true;
+    }
+
+    bool steal_back(size_t& task) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (tasks.empty())
+            return false;
+        task = tasks.back();
+        tasks.pop_back();
+        return true;
+    }
+};
+
+}  // namespace
+
+void ParallelNdjson::run(const std::vector<Chunk>& chunks,
+                         const std::function<void(size_t, JsonParser&)>& work) const {
+    unsigned n = nthreads;
+    if (chunks.size() < n)
+        n = chunks.size() ? chunks.size() : 1;
+    // 连续的块分给同一个线程，相邻的块在内存中也相邻
+    std::vector<WorkQueue> queues(n);
+    for (size_t k = 0; k < chunks.size(); k++)
+        queues[k * n / chunks.size()].tasks.push_back(k);
+
+    auto worker = [&](unsigned self) {
+        JsonParser parser(nullptr, 0);
+        size_t task;
+        while (true) {
+            bool found = queues[self].pop_front(task);
+            for (unsigned k = 1; !found && k < n; k++)
+                found = queues[(self + k) % n].steal_back(task);
+            // 块在开始前就全部入队，所有队列都空了说明没有剩下的工作
+            if (!found)
+                return;
+            work(task, parser);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < n; t++)
+        pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& thread : pool)
+        thread.join();
+}
+
+std::vector<Json> ParallelNdjson::parse(const char* data, size_t len) {
+    std::vector<Chunk> chunks = split(data, len);
+    std::vector<std::vector<Json>> results(chunks.size());
+    run(chunks, [&](size_t k, JsonParser& parser) {
+        parse_chunk(chunks[k].begin, chunks[k].end, parser,
+                    [&](const char*, Json& record) { results[k].push_back(std::move(record)); });
+    });
+    size_t total = 0;
+    for (auto& r : results)
+        total += r.size();
+    std::vector<Json> records;
+    records.reserve(total);
+    for (auto& r : results)
+        for (auto& record : r)
+            records.push_back(std::move(record));
+    return records;
+}
+
+void ParallelNdjson::parse(const char* data, size_t len, const Callback& callback) {
+    std::vector<Chunk> chunks = split(data, len);
+    run(chunks, [&](size_t k, JsonParser& parser) {
+        parse_chunk(chunks[k].begin, chunks[k].end, parser,
+                    [&](const char* line, Json& record) { callback(line - data, record); });
+    });
+}
+
+}  // namespace myjson
@@ -0,0 +1,42 @@
+#pragma once
+#include <functional>
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    多线程解析NDJSON：输入先在换行处切成大约chunk_size字节的块，
+    块按顺序平均分到每个线程的队列里，线程从自己队列的头部取块，自己的队列空了就从别的线程的队列尾部偷。
+    每个线程只用一个JsonParser，解析每一行时reset()到新的输入，复用内部的缓冲区。
+    只有空白的行会被跳过，解析失败的行得到带错误码的Json。
+*/
+class ParallelNdjson {
+public:
+    // threads为0时使用std::thread::hardware_concurrency()
+    explicit ParallelNdjson(unsigned threads = 0, size_t chunk_size = 1 << 20);
+
+    // 按照在输入中的顺序返回所有记录
+    std::vector<Json> parse(const char* data, size_t len);
+
+    // 每解析完一条记录就在工作线程中调用callback，参数是这一行在输入中的偏移和解析结果，
+    // 调用顺序不确定，callback需要自己处理线程安全
+    typedef std::function<void(size_t offset, Json& record)> Callback;
+    void parse(const char* data, size_t len, const Callback& callback);
+
+    unsigned threads() const { return nthreads; }
+
+private:
+    struct Chunk {
+        const char* begin;
+        const char* end;
+    };
+
+    std::vector<Chunk> split(const char* data, size_t len) const;
+    // 把chunks分给各个线程，每个线程对取到的块调用work(块的序号, parser)
+    void run(const std::vector<Chunk>& chunks, const std::function<void(size_t, JsonParser&)>& work) const;
+
+    unsigned nthreads;
+    size_t chunk_size;
+};
+
+}  // namespace myjson
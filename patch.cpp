@@ -0,0 +1,224 @@
+#include "patch.h"
+#include <algorithm>
+#include <vector>
+
+namespace myjson {
+
+void merge_patch(Json& target, const Json& patch) {
+    if (!patch.is_obejct()) {
+        target = patch;
+        return;
+    }
+    if (!target.is_obejct())
+        target = Json(Json::object());
+    for (auto& kv : patch.object_value()) {
+        const Json::object& current = target.object_value();
+        auto it = current.find(kv.first);
+        if (kv.second.is_null()) {
+            // 删除不存在的成员时不需要复制target
+            if (it != current.end())
+                target.mutable_object()->erase(kv.first);
+        } else if (it != current.end() && kv.second.is_obejct()) {
+            Json::object* o = target.mutable_object();
+            merge_patch(o->find(kv.first)->second, kv.second);
+        } else {
+            Json value;
+            merge_patch(value, kv.second);
+            target.mutable_object()->assign(Json::object::value_type(kv.first, std::move(value)));
+        }
+    }
+}
+
+namespace {
+
+typedef std::vector<string> Pointer;
+
+// 把JSON Pointer拆分为各层的key，"~1"和"~0"分别还原为'/'和'~'
+bool split_pointer(const string& expr, Pointer& out) {
+    out.clear();
+    if (expr.empty())
+        return true;
+    if (expr[0] != '/')
+        return false;
+    for (size_t p = 0; p < expr.size();) {
+        string key;
+        size_t q = p + 1;
+        for (; q < expr.size() && expr[q] != '/'; q++) {
+            if (expr[q] != '~') {
+                key += expr[q];
+            } else if (q + 1 < expr.size() && (expr[q + 1] == '0' || expr[q + 1] == '1')) {
+                key += expr[++q] == '0' ? '~' : '/';
+            } else {
+                return false;
+            }
+        }
+        out.push_back(std::move(key));
+        p = q;
+    }
+    return true;
+}
+
+// 数组的下标：不含多余前导0的十进制数
+bool to_index(const string& key, size_t& index) {
+    if (key.empty() || key.size() > 19 || (key[0] == '0' && key.size() > 1))
+        return false;
+    index = 0;
+    for (char ch : key) {
+        if (ch < '0' || ch > '9')
+            return false;
+        index = index * 10 + (ch - '0');
+    }
+    return true;
+}
+
+// 只读地查找，不复制任何节点
+const Json* find(const Json& doc, const Pointer& path, size_t depth) {
+    const Json* cur = &doc;
+    for (size_t k = 0; k < depth; k++) {
+        const string& key = path[k];
+        size_t index;
+        if (cur->is_obejct()) {
+            const Json::object& o = cur->object_value();
+            auto it = o.find(key);
+            if (it == o.end())
+                return nullptr;
+            cur = &it->second;
+        } else if (cur->is_array() && to_index(key, index) && index < cur->array_value().size()) {
+            cur = &cur->array_value()[index];
+        } else {
+            return nullptr;
+        }
+    }
+    return cur;
+}
+
+// 找到path所在的容器并准备修改它，沿途的节点按需复制
+Json* edit_parent(Json& doc, const Pointer& path) {
+    Json* cur = &doc;
+    for (size_t k = 0; k + 1 < path.size() && cur; k++) {
+        size_t index;
+        cur = cur->is_array() ? (to_index(path[k], index) ? cur->edit(index) : nullptr) : cur->edit(path[k]);
+    }
+    return cur;
+}
+
+State add(Json& doc, const Pointer& path, Json value) {
+    if (path.empty()) {
+        doc = std::move(value);
+        return JSON_PARSE_OK;
+    }
+    Json* parent = edit_parent(doc, path);
+    if (!parent)
+        return JSON_PARSE_PATH_NOT_FOUND;
+    const string& key = path.back();
+    if (parent->is_obejct()) {
+        parent->set(key, std::move(value));
+        return JSON_PARSE_OK;
+    }
+    size_t index;
+    if (!parent->is_array())
+        return JSON_PARSE_PATH_NOT_FOUND;
+    if (key == "-")
+        index = parent->array_value().size();
+    else if (!to_index(key, index))
+        return JSON_PARSE_PATH_NOT_FOUND;
+    return parent->insert(index, std::move(value)) ? JSON_PARSE_OK : JSON_PARSE_PATH_NOT_FOUND;
+}
+
+State remove(Json& doc, const Pointer& path) {
+    if (path.empty())
+        return JSON_PARSE_INVALID_PATCH;
+    Json* parent = edit_parent(doc, path);
+    size_t index;
+    if (parent && parent->is_obejct() && parent->erase(path.back()))
+        return JSON_PARSE_OK;
+    if (parent && parent->is_array() && to_index(path.back(), index) && parent->erase(index))
+        return JSON_PARSE_OK;
+    return JSON_PARSE_PATH_NOT_FOUND;
+}
+
+State replace(Json& doc, const Pointer& path, Json value) {
+    if (!find(doc, path, path.size()))
+        return JSON_PARSE_PATH_NOT_FOUND;
+    if (path.empty()) {
+        doc = std::move(value);
+        return JSON_PARSE_OK;
+    }
+    Json* parent = edit_parent(doc, path);
+    size_t index;
+    Json* target = parent->is_obejct() ? parent->edit(path.back())
+                 : to_index(path.back(), index) ? parent->edit(index) : nullptr;
+    *target = std::move(value);
+    return JSON_PARSE_OK;
+}
+
+State apply(Json& doc, const Json& op) {
+    const Json& name = op["op"];
+    const Json& path_expr = op["path"];
+    if (!name.is_string() || !path_expr.is_string())
+        return JSON_PARSE_INVALID_PATCH;
+    Pointer path, from;
+    if (!split_pointer(path_expr.string_value(), path))
+        return JSON_PARSE_INVALID_PATH;
+    StringView kind = name.string_view();
+    const Json::object& members = op.object_value();
+    bool has_value = members.find("value") != members.end();
+
+    if (kind == "add" || kind == "replace" || kind == "test") {
+        if (!has_value)
+            return JSON_PARSE_INVALID_PATCH;
+        const Json& value = op["value"];
+        if (kind == "add")
+            return add(doc, path, value);
+        if (kind == "replace")
+            return replace(doc, path, value);
+        const Json* target = find(doc, path, path.size());
+        if (!target)
+            return JSON_PARSE_PATH_NOT_FOUND;
+        return *target == value ? JSON_PARSE_OK : JSON_PARSE_TEST_FAILED;
+    }
+    if (kind == "remove")
+        return remove(doc, path);
+    if (kind == "move" || kind == "copy") {
+        const Json& from_expr = op["from"];
+        if (!from_expr.is_string())
+            return JSON_PARSE_INVALID_PATCH;
+        if (!split_pointer(from_expr.string_value(), from))
+            return JSON_PARSE_INVALID_PATH;
+        const Json* source = find(doc, from, from.size());
+        if (!source)
+            return JSON_PARSE_PATH_NOT_FOUND;
+        // 值只增加引用计数，不会被复制
+        Json value = *source;
+        if (kind == "copy")
+            return add(doc, path, std::move(value));
+        if (from == path)
+            return JSON_PARSE_OK;
+        // 不能移动到自己的子节点中
+        if (from.size() < path.size() && std::equal(from.begin(), from.end(), path.begin()))
+            return JSON_PARSE_INVALID_PATCH;
+        State s = remove(doc, from);
+        return s != JSON_PARSE_OK ? s : add(doc, path, std::move(value));
+    }
+    return JSON_PARSE_INVALID_PATCH;
+}
+
+}  // namespace
+
+State apply_patch(Json& doc, const Json& patch) {
+    if (!patch.is_array())
+        return JSON_PARSE_INVALID_PATCH;
+    // 浅拷贝只增加根节点的引用计数，第一次修改时才复制需要的路径
+    Json work = doc;
+    for (const Json& op : patch.array_value()) {
+        if (!op.is_obejct())
+            return JSON_PARSE_INVALID_PATCH;
+        State s = apply(work, op);
+        if (s != JSON_PARSE_OK)
+            return s;
+    }
+    doc = std::move(work);
+    return JSON_PARSE_OK;
+}
+
+}  // namespace myjson
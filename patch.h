@@ -0,0 +1,25 @@
+#pragma once
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    JSON Merge Patch（RFC 7386）：把patch合并到target中。
+    patch中值为null的成员删除target中对应的成员，对象递归合并，其余的值直接替换。
+    修改基于写时复制，只有被patch涉及的路径会被复制，target中其余的子树仍然和原来共享。
+*/
+void merge_patch(Json& target, const Json& patch);
+
+/*
+    JSON Patch（RFC 6902）：依次执行patch数组中的add、remove、replace、move、copy、test操作。
+    path和from是JSON Pointer（RFC 6901），数组的下标可以用"-"表示末尾。
+    操作在doc的一个浅拷贝上进行，全部成功后才替换doc，任何一个操作失败时doc保持不变。
+    出错时返回：
+        JSON_PARSE_INVALID_PATCH    操作的格式错误，比如缺少path、未知的op
+        JSON_PARSE_INVALID_PATH     path或from不是合法的JSON Pointer
+        JSON_PARSE_PATH_NOT_FOUND   path指向的值（add时是它所在的容器）不存在
+        JSON_PARSE_TEST_FAILED      test操作的值不相等
+*/
+State apply_patch(Json& doc, const Json& patch);
+
+}  // namespace myjson
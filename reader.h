@@ -0,0 +1,134 @@
+#pragma once
+#include "myjson.h"
+#include "number.h"
+
+namespace myjson {
+
+/*
+    SAX风格的解析：JsonParser::parse(handler)按照和Json::parse相同的语法和错误码解析输入，
+    但不构造Json，而是依次调用handler的成员函数：
+        bool null();
+        bool boolean(bool b);
+        bool number(const Number& n);
+        bool string(StringView s);
+        bool key(StringView s);
+        bool start_object();
+        bool end_object(size_t members);
+        bool start_array();
+        bool end_array(size_t elements);
+    任何一个函数返回false都会停止解析，此时返回JSON_PARSE_TERMINATED。
+    嵌套超过limit_depth()设置的深度时返回JSON_PARSE_TOO_DEEP。
+    传给string和key的StringView可能指向内部的缓冲区，只在这次调用中有效。
+    Handler是模板参数，每个事件都是静态分派的普通函数调用，可以被内联。
+    出错时可以用get_index()得到出错的位置。
+*/
+template <typename Handler>
+State JsonParser::parse(Handler& handler) {
+    if (!sax_value(handler))
+        return error;
+    parse_whitespace();
+    if (i != length)
+        return fail(JSON_PARSE_ROOT_NOT_SINGULAR, JSON_PARSE_ROOT_NOT_SINGULAR);
+    return JSON_PARSE_OK;
+}
+
+/*
+    和parse_json()一样用stack代替递归，SAX解析时Frame::base记录容器中已经读到的元素个数。
+    出错时丢弃这次调用压入的所有Frame。
+*/
+template <typename Handler>
+bool JsonParser::sax_value(Handler& handler) {
+    size_t bottom = stack.size();
+    char ch = get_next_token();
+    while (true) {
+        switch (ch) {
+            case 'n':
+                if (!match_literal("null")) return drop_frames(bottom, JSON_PARSE_INVALID_VALUE);
+                if (!emit(handler.null())) return drop_frames(bottom);
+                break;
+            case 't':
+                if (!match_literal("true")) return drop_frames(bottom, JSON_PARSE_INVALID_VALUE);
+                if (!emit(handler.boolean(true))) return drop_frames(bottom);
+                break;
+            case 'f':
+                if (!match_literal("false")) return drop_frames(bottom, JSON_PARSE_INVALID_VALUE);
+                if (!emit(handler.boolean(false))) return drop_frames(bottom);
+                break;
+            case '"': {
+                StringView s = parse_string_ref();
+                if (failed || !emit(handler.string(s))) return drop_frames(bottom);
+                break;
+            }
+            case '[':
+            case '{': {
+                bool object = ch == '{';
+                if (stack.size() - bottom >= max_depth)
+                    return drop_frames(bottom, JSON_PARSE_TOO_DEEP);
+                if (!emit(object ? handler.start_object() : handler.start_array()))
+                    return drop_frames(bottom);
+                stack.push_back(Frame{object, 0});
+                ch = get_next_token();
+                if (ch == (object ? '}' : ']')) {
+                    stack.pop_back();
+                    if (!emit(object ? handler.end_object(0) : handler.end_array(0)))
+                        return drop_frames(bottom);
+                    break;
+                }
+                if (object && !sax_key(handler, ch))
+                    return drop_frames(bottom);
+                continue;
+            }
+            case '\0':
+                return drop_frames(bottom, JSON_PARSE_EXPECT_VALUE);
+            default: {
+                i--;
+                const char* p = str + i;
+                Number n;
+                State s = scan_number(p, str + length, n);
+                if (s != JSON_PARSE_OK)
+                    return drop_frames(bottom, s);
+                i = p - str;
+                if (!emit(handler.number(n))) return drop_frames(bottom);
+            }
+        }
+        // 一个值结束，读取所在容器中的逗号或者结束符
+        while (true) {
+            if (stack.size() == bottom)
+                return true;
+            Frame& top = stack.back();
+            top.base++;
+            bool object = top.object;
+            ch = get_next_token();
+            if (ch == (object ? '}' : ']')) {
+                size_t count = top.base;
+                stack.pop_back();
+                if (!emit(object ? handler.end_object(count) : handler.end_array(count)))
+                    return drop_frames(bottom);
+                continue;
+            }
+            if (ch != ',')
+                return drop_frames(bottom, object ? JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+                                                  : JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET);
+            ch = get_next_token();
+            if (object && !sax_key(handler, ch))
+                return drop_frames(bottom);
+            break;
+        }
+    }
+}
+
+// 读取对象成员的key和冒号，成功时ch是值的第一个字符
+template <typename Handler>
+bool JsonParser::sax_key(Handler& handler, char& ch) {
+    if (ch != '"')
+        return fail(false, JSON_PARSE_MISS_KEY);
+    StringView key = parse_string_ref();
+    if (failed || !emit(handler.key(key)))
+        return false;
+    if (get_next_token() != ':')
+        return fail(false, JSON_PARSE_MISS_COLON);
+    ch = get_next_token();
+    return true;
+}
+
+}  // namespace myjson
@@ -0,0 +1,665 @@
+#include "schema.h"
+#include <algorithm>
+#include <cctype>
+#include "number.h"
+#include "reader.h"
+
+namespace myjson {
+
+namespace {
+
+// 编译时遇到这些关键字就失败：忽略它们会让本该拒绝的值通过检查
+const char* const unsupported[] = {
+    "$ref", "allOf", "anyOf", "oneOf", "not", "if", "then", "else", "contains", "uniqueItems",
+    "multipleOf", "patternProperties", "propertyNames", "dependencies", "dependentRequired",
+    "dependentSchemas", "prefixItems", "unevaluatedItems", "unevaluatedProperties",
+};
+
+// 下标和Json::Type一致
+const char* const type_names[] = {"null", "boolean", "number", "string", "array", "object"};
+
+bool integral(double d) { return d == std::floor(d); }
+
+// minLength这类关键字的值：非负整数
+bool to_count(const Json& v, size_t& out) {
+    if (!v.is_number() || v.number_value() < 0 || !integral(v.number_value()))
+        return false;
+    double d = v.number_value();
+    out = v.is_integer() ? static_cast<size_t>(v.uint64_value())
+        : d >= 18446744073709551616.0 ? SIZE_MAX : static_cast<size_t>(d);
+    return true;
+}
+
+// 数字关键字的值必须是有限的数：代码中构造的NaN、Inf和任何边界比较都是false
+bool finite_number(const Json& v) { return v.is_number() && std::isfinite(v.number_value()); }
+
+// schema可能在Document中，编译之后不能再引用它的节点，所以enum的值逐层复制到堆上。
+// key也重新构造，不依赖Arena或InternPool。含有非有限的数字时返回false
+bool deep_copy(const Json& v, Json& out) {
+    switch (v.type()) {
+        case Json::JSON_NUMBER:
+            out = v;
+            return std::isfinite(v.number_value());
+        case Json::JSON_STRING:
+            out = Json(v.string_view().to_string());
+            return true;
+        case Json::JSON_ARRAY: {
+            Json::array a(v.array_value().size());
+            for (size_t k = 0; k < a.size(); k++)
+                if (!deep_copy(v.array_value()[k], a[k]))
+                    return false;
+            out = Json(std::move(a));
+            return true;
+        }
+        case Json::JSON_OBJECT: {
+            Json::object o;
+            o.reserve(v.object_value().size());
+            for (auto& kv : v.object_value())
+                if (!deep_copy(kv.second, o[Key(kv.first.data(), kv.first.size())]))
+                    return false;
+            out = Json(std::move(o));
+            return true;
+        }
+        default:
+            out = v;
+            return true;
+    }
+}
+
+// 识别^[...]+$和^[...]*$，集合中只能有ASCII字符、区间和\d、\w，其余的pattern交给std::regex
+bool simple_class(StringView p, uint64_t set[4], bool& allow_empty) {
+    size_t n = p.size();
+    if (n < 5 || p[0] != '^' || p[1] != '[' || p[2] == '^' || p[n - 1] != '$' || p[n - 3] != ']' ||
+        (p[n - 2] != '+' && p[n - 2] != '*'))
+        return false;
+    allow_empty = p[n - 2] == '*';
+    auto add = [set](unsigned char lo, unsigned char hi) {
+        for (unsigned c = lo; c <= hi; c++)
+            set[c >> 6] |= uint64_t(1) << (c & 63);
+    };
+    for (size_t k = 2, end = n - 3; k < end;) {
+        unsigned char c = p[k];
+        if (c >= 0x80 || c == '[' || c == ']')
+            return false;
+        if (c == '\\') {
+            // 转义的字符作为区间的开头（比如[\--z]）也交给std::regex
+            if (k + 1 >= end || (k + 3 < end && p[k + 2] == '-'))
+                return false;
+            unsigned char e = p[k + 1];
+            if (e == 'd') {
+                add('0', '9');
+            } else if (e == 'w') {
+                add('0', '9');
+                add('A', 'Z');
+                add('a', 'z');
+                add('_', '_');
+            } else if (e < 0x80 && !std::isalnum(e)) {
+                add(e, e);
+            } else {
+                return false;
+            }
+            k += 2;
+        } else if (k + 2 < end && p[k + 1] == '-') {
+            unsigned char hi = p[k + 2];
+            if (hi >= 0x80 || hi == '\\' || hi == '[' || hi == ']' || hi < c)
+                return false;
+            add(c, hi);
+            k += 3;
+        } else {
+            add(c, c);
+            k++;
+        }
+    }
+    return true;
+}
+
+// 和JSON Pointer一样，'~'和'/'分别写成"~0"和"~1"
+void append_segment(string& out, const char* s, size_t n) {
+    out += '/';
+    for (size_t k = 0; k < n; k++) {
+        if (s[k] == '~')
+            out += "~0";
+        else if (s[k] == '/')
+            out += "~1";
+        else
+            out += s[k];
+    }
+}
+
+}  // namespace
+
+/*
+    编译
+*/
+
+State JsonSchema::compile(const Json& schema) {
+    nodes.assign(2, Node());
+    nodes[never].types = 0;
+    bool ok = true;
+    root = compile_node(schema, ok);
+    return ok ? JSON_PARSE_OK : JSON_PARSE_INVALID_SCHEMA;
+}
+
+// 子schema先编译，所以子节点的下标总是小于父节点。没有任何约束的schema（比如{}）直接是any
+uint32_t JsonSchema::compile_node(const Json& schema, bool& ok) {
+    if (schema.is_bool())
+        return schema.bool_value() ? any : never;
+    if (!schema.is_obejct()) {
+        ok = false;
+        return never;
+    }
+    const Json::object& o = schema.object_value();
+    auto get = [&o](const char* name) -> const Json* {
+        auto it = o.find(name);
+        return it == o.end() ? nullptr : &it->second;
+    };
+    for (const char* name : unsupported) {
+        if (get(name)) {
+            ok = false;
+            return never;
+        }
+    }
+    Node node;
+    bool trivial = true;
+
+    if (const Json* v = get("type")) {
+        node.types = 0;
+        const Json* list = v->is_array() ? v->array_value().data() : v;
+        size_t n = v->is_array() ? v->array_value().size() : 1;
+        for (size_t k = 0; k < n; k++) {
+            StringView name = list[k].is_string() ? list[k].string_view() : StringView();
+            size_t t = 0;
+            while (t < 6 && name != type_names[t])
+                t++;
+            if (t < 6)
+                node.types |= 1 << t;
+            else if (name == "integer")
+                node.types |= integer_bit;
+            else
+                ok = false;
+        }
+        trivial = false;
+    }
+
+    // 数字的范围：exclusiveMinimum是bool时（draft 4）修饰minimum，是数字时和minimum取更严格的一个
+    if (const Json* v = get("minimum")) {
+        ok &= finite_number(*v);
+        node.lo = v->number_value();
+    }
+    if (const Json* v = get("exclusiveMinimum")) {
+        if (v->is_bool()) {
+            node.lo_open = v->bool_value();
+        } else if (finite_number(*v)) {
+            if (v->number_value() >= node.lo) {
+                node.lo = v->number_value();
+                node.lo_open = true;
+            }
+        } else {
+            ok = false;
+        }
+    }
+    if (const Json* v = get("maximum")) {
+        ok &= finite_number(*v);
+        node.hi = v->number_value();
+    }
+    if (const Json* v = get("exclusiveMaximum")) {
+        if (v->is_bool()) {
+            node.hi_open = v->bool_value();
+        } else if (finite_number(*v)) {
+            if (v->number_value() <= node.hi) {
+                node.hi = v->number_value();
+                node.hi_open = true;
+            }
+        } else {
+            ok = false;
+        }
+    }
+    if (node.lo != -HUGE_VAL || node.hi != HUGE_VAL)
+        trivial = false;
+
+    struct Count {
+        const char* name;
+        size_t* out;
+    } counts[] = {
+        {"minLength", &node.min_length}, {"maxLength", &node.max_length},
+        {"minItems", &node.min_items}, {"maxItems", &node.max_items},
+        {"minProperties", &node.min_members}, {"maxProperties", &node.max_members},
+    };
+    for (const Count& c : counts) {
+        if (const Json* v = get(c.name)) {
+            ok &= to_count(*v, *c.out);
+            trivial = false;
+        }
+    }
+    if (node.min_length > 0 || node.max_length != SIZE_MAX)
+        node.checks |= CHECK_LENGTH;
+
+    if (const Json* v = get("pattern")) {
+        if (v->is_string()) {
+            StringView s = v->string_view();
+            try {
+                Pattern pattern;
+                pattern.re.assign(s.data(), s.size(), std::regex::ECMAScript);
+                pattern.simple = simple_class(s, pattern.set, pattern.allow_empty);
+                patterns.push_back(std::move(pattern));
+                node.pattern = static_cast<uint32_t>(patterns.size() - 1);
+                node.checks |= CHECK_PATTERN;
+            } catch (const std::regex_error&) {
+                ok = false;
+            }
+        } else {
+            ok = false;
+        }
+    }
+
+    // enum和const同时出现时，只有const的值可能通过
+    const Json* values = get("enum");
+    const Json* constant = get("const");
+    if (values || constant) {
+        node.enum_first = static_cast<uint32_t>(enums.size());
+        node.checks |= CHECK_ENUM;
+        if (values && !values->is_array()) {
+            ok = false;
+        } else if (constant) {
+            const Json::array* list = values ? &values->array_value() : nullptr;
+            if (!list || std::find(list->begin(), list->end(), *constant) != list->end()) {
+                enums.emplace_back();
+                ok &= deep_copy(*constant, enums.back());
+            }
+        } else {
+            for (const Json& value : values->array_value()) {
+                enums.emplace_back();
+                ok &= deep_copy(value, enums.back());
+            }
+        }
+        node.enum_count = static_cast<uint32_t>(enums.size() - node.enum_first);
+        for (size_t k = node.enum_first; k < enums.size(); k++)
+            enum_hashes.push_back(enums[k].hash());
+    }
+
+    if (const Json* v = get("items")) {
+        // 数组形式（每个位置一个schema）不支持
+        if (v->is_array())
+            ok = false;
+        else
+            node.items = compile_node(*v, ok);
+    }
+    if (const Json* v = get("additionalProperties"))
+        node.additional = compile_node(*v, ok);
+
+    // 成员的名字按照properties中的顺序，之后是只在required中出现的名字
+    std::vector<Property> own;
+    std::vector<StringView> list;
+    if (const Json* v = get("properties")) {
+        if (v->is_obejct()) {
+            for (auto& kv : v->object_value()) {
+                own.push_back(Property{compile_node(kv.second, ok), false});
+                names.push_back(string(kv.first.data(), kv.first.size()));
+                list.push_back(StringView(names.back()));
+            }
+        } else {
+            ok = false;
+        }
+    }
+    if (const Json* v = get("required")) {
+        if (v->is_array()) {
+            for (const Json& name : v->array_value()) {
+                if (!name.is_string()) {
+                    ok = false;
+                    continue;
+                }
+                size_t k = std::find(list.begin(), list.end(), name.string_view()) - list.begin();
+                if (k == list.size()) {
+                    own.push_back(Property{any, false});
+                    names.push_back(name.string_value());
+                    list.push_back(StringView(names.back()));
+                }
+                if (!own[k].required)
+                    node.required++;
+                own[k].required = true;
+            }
+        } else {
+            ok = false;
+        }
+    }
+    if (!own.empty()) {
+        node.first = static_cast<uint32_t>(props.size());
+        props.insert(props.end(), own.begin(), own.end());
+        node.table = static_cast<uint32_t>(tables.size());
+        tables.emplace_back(std::move(list));
+    }
+    if (node.table != none || node.additional != any)
+        node.checks |= CHECK_MEMBERS;
+    if (node.checks || node.items != any)
+        trivial = false;
+
+    if (trivial)
+        return any;
+    nodes.push_back(node);
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+/*
+    检查
+*/
+
+bool JsonSchema::match_string(const Node& node, StringView s) const {
+    if (node.checks & CHECK_LENGTH) {
+        // 码点的个数在[字节数/4, 字节数]之间，大多数时候不需要数
+        size_t n = s.size();
+        if (n > node.max_length || (n + 3) / 4 < node.min_length) {
+            n = 0;
+            for (char ch : s)
+                n += (static_cast<unsigned char>(ch) & 0xC0) != 0x80;
+            if (n < node.min_length || n > node.max_length)
+                return false;
+        }
+    }
+    if (!(node.checks & CHECK_PATTERN))
+        return true;
+    const Pattern& pattern = patterns[node.pattern];
+    if (!pattern.simple)
+        return std::regex_search(s.begin(), s.end(), pattern.re);
+    for (char ch : s) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (!(pattern.set[c >> 6] >> (c & 63) & 1))
+            return false;
+    }
+    return pattern.allow_empty || !s.empty();
+}
+
+// 先比较预先算好的hash，相等时才逐个比较
+bool JsonSchema::match_enum(const Node& node, const Json& v) const {
+    uint64_t h = v.hash();
+    for (uint32_t k = node.enum_first; k < node.enum_first + node.enum_count; k++)
+        if (enum_hashes[k] == h && enums[k] == v)
+            return true;
+    return false;
+}
+
+// SAX得到的字符串，直接比较而不构造Json
+bool JsonSchema::match_enum(const Node& node, StringView s) const {
+    for (uint32_t k = node.enum_first; k < node.enum_first + node.enum_count; k++)
+        if (enums[k].is_string() && enums[k].string_view() == s)
+            return true;
+    return false;
+}
+
+/*
+    required用时间戳记录：每检查一个对象取一个新的stamp，成员出现时把它在props中的位置标记为stamp，
+    这样重复的key只计一次，也不需要为每个对象清空标记。
+*/
+struct JsonSchema::Context {
+    std::vector<uint32_t> seen;
+    uint32_t stamp = 0;
+    std::vector<string> path;   // 出错时从内向外记录路径
+
+    uint32_t next_stamp(size_t n) {
+        if (seen.size() < n)
+            seen.resize(n);
+        if (++stamp == 0) {
+            std::fill(seen.begin(), seen.end(), 0);
+            stamp = 1;
+        }
+        return stamp;
+    }
+};
+
+bool JsonSchema::check(uint32_t n, const Json& v, Context& c) const {
+    if (n == any)
+        return true;
+    const Node& node = nodes[n];
+    Json::Type t = v.type();
+    if (!match_type(node, t, t == Json::JSON_NUMBER && (v.is_integer() || integral(v.number_value()))))
+        return false;
+    if ((node.checks & CHECK_ENUM) && !match_enum(node, v))
+        return false;
+    switch (t) {
+        case Json::JSON_NUMBER:
+            return in_range(node, v.number_value());
+        case Json::JSON_STRING:
+            return match_string(node, v.string_view());
+        case Json::JSON_ARRAY: {
+            const Json::array& a = v.array_value();
+            if (a.size() < node.min_items || a.size() > node.max_items)
+                return false;
+            if (node.items == any)
+                return true;
+            for (size_t k = 0; k < a.size(); k++) {
+                if (!check(node.items, a[k], c)) {
+                    c.path.push_back(std::to_string(k));
+                    return false;
+                }
+            }
+            return true;
+        }
+        case Json::JSON_OBJECT: {
+            const Json::object& o = v.object_value();
+            if (o.size() < node.min_members || o.size() > node.max_members)
+                return false;
+            if (!(node.checks & CHECK_MEMBERS))
+                return true;
+            uint32_t stamp = node.required ? c.next_stamp(props.size()) : 0;
+            uint32_t found = 0;
+            size_t hint = 0;
+            for (auto& kv : o) {
+                uint32_t child = node.additional;
+                size_t k = node.table == none ? KeyTable::npos : tables[node.table].find(kv.first, hint);
+                if (k != KeyTable::npos) {
+                    const Property& p = props[node.first + k];
+                    child = p.node;
+                    hint = k + 1;
+                    if (p.required && c.seen[node.first + k] != stamp) {
+                        c.seen[node.first + k] = stamp;
+                        found++;
+                    }
+                }
+                if (!check(child, kv.second, c)) {
+                    c.path.push_back(string(kv.first.data(), kv.first.size()));
+                    return false;
+                }
+            }
+            return found == node.required;
+        }
+        default:
+            return true;
+    }
+}
+
+State JsonSchema::validate(const Json& doc, string* pointer) const {
+    if (error)
+        return error;
+    Context c;
+    if (pointer)
+        pointer->clear();
+    if (check(root, doc, c))
+        return JSON_PARSE_OK;
+    if (pointer) {
+        for (size_t k = c.path.size(); k-- > 0;)
+            append_segment(*pointer, c.path[k].data(), c.path[k].size());
+    }
+    return JSON_PARSE_SCHEMA_MISMATCH;
+}
+
+/*
+    Checker：边解析边检查的SAX handler。frames对应解析器中打开的每一层容器，
+    child是下一个值要满足的节点：数组是items，对象在读到key时确定。
+    frames中的Frame重复使用，key的内存不会反复分配。
+*/
+class JsonSchema::Checker {
+public:
+    Checker(const JsonSchema& schema, const char* in, const JsonParser& parser)
+        : schema(schema), in(in), parser(parser) {}
+
+    bool failed = false;
+    std::string where;   // 成员函数string()隐藏了类型名
+
+    bool null() { return scalar(Json()); }
+    bool boolean(bool b) { return scalar(Json(b)); }
+
+    bool number(const Number& n) {
+        uint32_t id = expected();
+        if (id == any)
+            return done();
+        const Node& node = schema.nodes[id];
+        double d = n.kind == Number::INT ? static_cast<double>(n.i)
+                 : n.kind == Number::UINT ? static_cast<double>(n.u) : n.d;
+        if (!schema.match_type(node, Json::JSON_NUMBER, n.kind != Number::DOUBLE || integral(d)) ||
+            !schema.in_range(node, d))
+            return mismatch(depth);
+        if (node.checks & CHECK_ENUM) {
+            Json v = n.kind == Number::INT ? Json(n.i) : n.kind == Number::UINT ? Json(n.u) : Json(n.d);
+            if (!schema.match_enum(node, v))
+                return mismatch(depth);
+        }
+        return done();
+    }
+
+    bool string(StringView s) {
+        uint32_t id = expected();
+        if (id == any)
+            return done();
+        const Node& node = schema.nodes[id];
+        if (!schema.match_type(node, Json::JSON_STRING, false) ||
+            ((node.checks & CHECK_ENUM) && !schema.match_enum(node, s)) || !schema.match_string(node, s))
+            return mismatch(depth);
+        return done();
+    }
+
+    bool key(StringView s) {
+        Frame& f = frames[depth - 1];
+        f.child = any;
+        if (f.node == any)
+            return true;
+        const Node& node = schema.nodes[f.node];
+        if (!(node.checks & CHECK_MEMBERS))
+            return true;
+        f.child = node.additional;
+        size_t k = node.table == none ? KeyTable::npos : schema.tables[node.table].find(s, f.hint);
+        if (k != KeyTable::npos) {
+            const Property& p = schema.props[node.first + k];
+            f.child = p.node;
+            f.hint = k + 1;
+            if (p.required && c.seen[node.first + k] != f.stamp) {
+                c.seen[node.first + k] = f.stamp;
+                f.found++;
+            }
+        }
+        // 只有值还要检查时才需要记下key，出错时用于生成路径
+        if (f.child != any)
+            f.key.assign(s.data(), s.size());
+        // additionalProperties为false时不用读取值就可以拒绝
+        return f.child != never || mismatch(depth);
+    }
+
+    bool start_object() { return open(true); }
+    bool start_array() { return open(false); }
+    bool end_object(size_t members) { return close(members); }
+    bool end_array(size_t elements) { return close(elements); }
+
+private:
+    struct Frame {
+        uint32_t node;
+        uint32_t child;
+        uint32_t stamp;
+        uint32_t found;     // 出现过的required成员个数
+        size_t hint;
+        size_t count;       // 已经读完的值的个数，数组中就是下一个元素的下标
+        size_t start;       // 容器在输入中的开头，enum需要重新解析这一段
+        bool object;
+        std::string key;
+    };
+
+    uint32_t expected() const { return depth == 0 ? schema.root : frames[depth - 1].child; }
+
+    // 一个值检查完毕
+    bool done() {
+        if (depth > 0)
+            frames[depth - 1].count++;
+        return true;
+    }
+
+    bool scalar(const Json& v) {
+        uint32_t id = expected();
+        if (id == any)
+            return done();
+        const Node& node = schema.nodes[id];
+        if (!schema.match_type(node, v.type(), false) || ((node.checks & CHECK_ENUM) && !schema.match_enum(node, v)))
+            return mismatch(depth);
+        return done();
+    }
+
+    bool open(bool object) {
+        uint32_t id = expected();
+        const Node* node = id == any ? nullptr : &schema.nodes[id];
+        if (node && !schema.match_type(*node, object ? Json::JSON_OBJECT : Json::JSON_ARRAY, false))
+            return mismatch(depth);
+        if (depth == frames.size())
+            frames.emplace_back();
+        Frame& f = frames[depth++];
+        f.node = id;
+        f.child = node && !object ? node->items : any;
+        f.stamp = node && object && node->required ? c.next_stamp(schema.props.size()) : 0;
+        f.found = 0;
+        f.hint = 0;
+        f.count = 0;
+        // 解析器刚刚读过'{'或'['
+        f.start = parser.get_index() - 1;
+        f.object = object;
+        return true;
+    }
+
+    bool close(size_t count) {
+        const Frame& f = frames[depth - 1];
+        if (f.node != any) {
+            const Node& node = schema.nodes[f.node];
+            bool ok = f.object ? count >= node.min_members && count <= node.max_members && f.found == node.required
+                               : count >= node.min_items && count <= node.max_items;
+            if (ok && (node.checks & CHECK_ENUM))
+                ok = schema.match_enum(node, Json::parse(in + f.start, parser.get_index() - f.start));
+            if (!ok)
+                return mismatch(depth - 1);
+        }
+        depth--;
+        return done();
+    }
+
+    // 出错的值在前n层容器中，记下它的路径并停止解析
+    bool mismatch(size_t n) {
+        failed = true;
+        for (size_t k = 0; k < n; k++) {
+            const Frame& f = frames[k];
+            if (f.object) {
+                append_segment(where, f.key.data(), f.key.size());
+            } else {
+                std::string index = std::to_string(f.count);
+                append_segment(where, index.data(), index.size());
+            }
+        }
+        return false;
+    }
+
+    const JsonSchema& schema;
+    const char* in;
+    const JsonParser& parser;
+    Context c;
+    std::vector<Frame> frames;
+    size_t depth = 0;
+};
+
+State JsonSchema::validate_text(const char* in, size_t len, string* pointer, size_t* error_offset) const {
+    if (error)
+        return error;
+    JsonParser parser(in, len);
+    Checker checker(*this, in, parser);
+    State s = parser.parse(checker);
+    if (s == JSON_PARSE_TERMINATED && checker.failed)
+        s = JSON_PARSE_SCHEMA_MISMATCH;
+    if (pointer)
+        *pointer = s == JSON_PARSE_SCHEMA_MISMATCH ? checker.where : string();
+    if (error_offset)
+        *error_offset = s == JSON_PARSE_OK ? len : parser.get_index();
+    return s;
+}
+
+}  // namespace myjson
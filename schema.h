@@ -0,0 +1,132 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <regex>
+#include <vector>
+#include "bind.h"
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    JsonSchema：把JSON Schema编译成一个扁平的检查程序，编译一次，之后检查任意多个文档。
+    支持的关键字：
+        type（包括"integer"和数组形式）、enum、const
+        minimum、maximum、exclusiveMinimum、exclusiveMaximum（数字和draft 4的bool两种写法都可以）
+        minLength、maxLength（按Unicode码点计数）、pattern（ECMAScript正则，不锚定）
+        items（单个schema）、minItems、maxItems
+        properties、required、additionalProperties（bool或schema）、minProperties、maxProperties
+    schema本身也可以是true或false。title、description、format等不影响结果的关键字被忽略；
+    $ref、allOf、anyOf、not、uniqueItems等不支持的关键字会使编译失败，而不是被悄悄地忽略。
+    在代码中构造的schema如果在enum、const或数字关键字中含有NaN、Inf，同样编译失败。
+
+    每个子schema编译为nodes中的一项，子schema用下标引用。对象的properties和required的名字放在
+    一张完美哈希表（KeyTable）中，检查一个成员只需要一次查找和一次字符串比较；
+    没有约束的子树（true或者没有写出的成员）直接跳过，不会访问其中的值。
+    编译时复制了需要的全部数据，schema的Json（包括Document中的）之后可以释放。
+    检查不修改JsonSchema，多个线程可以同时使用同一个JsonSchema。
+*/
+class JsonSchema {
+public:
+    JsonSchema() = default;
+    explicit JsonSchema(const Json& schema) { error = compile(schema); }
+    JsonSchema(const JsonSchema&) = delete;
+    JsonSchema& operator=(const JsonSchema&) = delete;
+    JsonSchema(JsonSchema&&) = default;
+    JsonSchema& operator=(JsonSchema&&) = default;
+
+    // schema不合法时为JSON_PARSE_INVALID_SCHEMA，之后的检查都返回这个错误。没有编译过的JsonSchema接受任何值
+    State state() const { return error; }
+
+    // 检查解析好的Json，不符合时返回JSON_PARSE_SCHEMA_MISMATCH，pointer得到出错的值的JSON Pointer
+    // required、minProperties这类对整个对象的要求没有满足时，pointer指向这个对象
+    State validate(const Json& doc, string* pointer = nullptr) const;
+
+    /*
+        边解析边检查，不构造Json。遇到第一个不符合schema的值就停止解析，后面的输入不再读取，
+        所以不合格的请求可以在构造Json之前、甚至读完之前被拒绝。
+        语法错误返回解析的错误码。error_offset和Json::validate一样，得到停止的位置。
+        enum和const中有数组或对象时，这一段输入会单独解析为Json再比较。
+        对象中有重复的key时，解析出的Json只保留最后一个，而这里每一个都要符合schema。
+    */
+    State validate_text(const char* in, size_t len, string* pointer = nullptr, size_t* error_offset = nullptr) const;
+    State validate_text(const string& in, string* pointer = nullptr, size_t* error_offset = nullptr) const {
+        return validate_text(in.data(), in.size(), pointer, error_offset);
+    }
+
+private:
+    class Checker;
+    struct Context;
+
+    // 0号节点接受任何值，1号节点拒绝任何值
+    static const uint32_t any = 0;
+    static const uint32_t never = 1;
+    static const uint32_t none = static_cast<uint32_t>(-1);
+    static const uint8_t integer_bit = 1 << 6;     // types中表示整数，其余的位是1 << Json::Type
+
+    enum Check : uint8_t {
+        CHECK_ENUM = 1,
+        CHECK_LENGTH = 2,
+        CHECK_PATTERN = 4,
+        CHECK_MEMBERS = 8,      // properties、required或者additionalProperties
+    };
+
+    struct Node {
+        uint8_t types = 0x7F;
+        uint8_t checks = 0;
+        bool lo_open = false;
+        bool hi_open = false;
+        double lo = -HUGE_VAL;
+        double hi = HUGE_VAL;
+        size_t min_length = 0, max_length = SIZE_MAX;
+        size_t min_items = 0, max_items = SIZE_MAX;
+        size_t min_members = 0, max_members = SIZE_MAX;
+        uint32_t items = any;
+        uint32_t additional = any;
+        uint32_t table = none;      // 成员名字的KeyTable在tables中的下标
+        uint32_t first = 0;         // 这些名字在props中的开头
+        uint32_t required = 0;      // required的名字个数
+        uint32_t enum_first = 0, enum_count = 0;
+        uint32_t pattern = none;
+    };
+
+    struct Property {
+        uint32_t node;
+        bool required;
+    };
+
+    // 形如^[a-z0-9_]+$的pattern只需要检查每个字节是否在集合中，不经过std::regex
+    struct Pattern {
+        std::regex re;
+        bool simple = false;
+        bool allow_empty = false;   // 是*而不是+
+        uint64_t set[4] = {};
+    };
+
+    State compile(const Json& schema);
+    uint32_t compile_node(const Json& schema, bool& ok);
+
+    bool check(uint32_t n, const Json& v, Context& c) const;
+    bool match_type(const Node& node, Json::Type t, bool integral) const {
+        return (node.types >> t & 1) || (t == Json::JSON_NUMBER && integral && (node.types & integer_bit));
+    }
+    bool in_range(const Node& node, double d) const {
+        return !(d < node.lo || d > node.hi || (node.lo_open && d == node.lo) || (node.hi_open && d == node.hi));
+    }
+    bool match_string(const Node& node, StringView s) const;
+    bool match_enum(const Node& node, const Json& v) const;
+    bool match_enum(const Node& node, StringView s) const;
+
+    std::vector<Node> nodes;
+    std::vector<Property> props;
+    std::vector<KeyTable> tables;
+    std::deque<string> names;       // tables中的StringView指向这里，添加和移动都不会改变字符串的位置
+    std::vector<Json> enums;
+    std::vector<uint64_t> enum_hashes;
+    std::vector<Pattern> patterns;
+    uint32_t root = any;
+    State error = JSON_PARSE_OK;
+};
+
+}  // namespace myjson
@@ -0,0 +1,382 @@
+#include "simd.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYJSON_X86 1
+#endif
+
+namespace myjson {
+namespace simd {
+
+static inline bool is_whitespace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+static inline bool is_special(char ch) {
+    return ch == '"' || ch == '\\' || static_cast<unsigned char>(ch) < 0x20;
+}
+
+/*
+    逐字节的实现，也用来处理向量实现剩下的不足一个向量的尾部
+*/
+static const char* skip_whitespace_scalar(const char* p, const char* end) {
+    while (p != end && is_whitespace(*p))
+        p++;
+    return p;
+}
+
+static const char* scan_string_scalar(const char* p, const char* end) {
+    while (p != end && !is_special(*p))
+        p++;
+    return p;
+}
+
+static inline bool is_op(char ch) {
+    return ch == '{' || ch == '}' || ch == '[' || ch == ']' || ch == ':' || ch == ',';
+}
+
+static void classify_scalar(const char* p, Masks& m) {
+    m.quote = m.backslash = m.op = 0;
+    for (int k = 0; k < 64; k++) {
+        uint64_t bit = uint64_t(1) << k;
+        if (p[k] == '"') m.quote |= bit;
+        if (p[k] == '\\') m.backslash |= bit;
+        if (is_op(p[k])) m.op |= bit;
+    }
+}
+
+/*
+    检查p开始的一个UTF-8序列，合法时返回序列的结尾，否则返回nullptr。
+    第二个字节的范围取决于第一个字节：E0后面不能小于A0（过长编码），ED后面不能大于9F（代理项），
+    F0后面不能小于90（过长编码），F4后面不能大于8F（超过U+10FFFF）
+*/
+static inline const char* utf8_sequence(const char* p, const char* end) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    if (c < 0x80)
+        return p + 1;
+    int n;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (c < 0xC2) return nullptr;
+    else if (c < 0xE0) n = 1;
+    else if (c < 0xF0) n = 2, lo = c == 0xE0 ? 0xA0 : 0x80, hi = c == 0xED ? 0x9F : 0xBF;
+    else if (c < 0xF5) n = 3, lo = c == 0xF0 ? 0x90 : 0x80, hi = c == 0xF4 ? 0x8F : 0xBF;
+    else return nullptr;
+    if (end - p <= n)
+        return nullptr;
+    unsigned char c1 = static_cast<unsigned char>(p[1]);
+    if (c1 < lo || c1 > hi)
+        return nullptr;
+    for (int k = 2; k <= n; k++)
+        if ((static_cast<unsigned char>(p[k]) & 0xC0) != 0x80)
+            return nullptr;
+    return p + n + 1;
+}
+
+static const char* validate_utf8_scalar(const char* p, const char* end) {
+    while (p != end) {
+        const char* q = utf8_sequence(p, end);
+        if (!q)
+            return p;
+        p = q;
+    }
+    return p;
+}
+
+#ifdef MYJSON_X86
+
+/*
+    SSE2：一次比较16字节，得到的掩码中第一个为1的位就是要找的位置。
+    无符号比较x < 0x20用max_epu8(x, 0x1F) == 0x1F代替。
+*/
+__attribute__((target("sse2")))
+static const char* skip_whitespace_sse2(const char* p, const char* end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, space), _mm_cmpeq_epi8(x, tab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(x, lf), _mm_cmpeq_epi8(x, cr)));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(ws)) & 0xFFFF;
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    return skip_whitespace_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char* scan_string_sse2(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1F);
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    return scan_string_scalar(p, end);
+}
+
+// 分4次处理16字节，把4个16位的掩码拼成64位
+__attribute__((target("sse2")))
+static void classify_sse2(const char* p, Masks& m) {
+    m.quote = m.backslash = m.op = 0;
+    for (int k = 0; k < 64; k += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + k));
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('{')), _mm_cmpeq_epi8(x, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('[')), _mm_cmpeq_epi8(x, _mm_set1_epi8(']'))),
+                         _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(':')), _mm_cmpeq_epi8(x, _mm_set1_epi8(',')))));
+        m.quote |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('"'))) & 0xFFFF) << k;
+        m.backslash |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\\'))) & 0xFFFF) << k;
+        m.op |= uint64_t(_mm_movemask_epi8(op) & 0xFFFF) << k;
+    }
+}
+
+// 跳过全是ASCII的16字节，遇到非ASCII的字节时逐个序列检查，直到越过这16字节
+__attribute__((target("sse2")))
+static const char* validate_utf8_sse2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(x));
+        if (!mask) {
+            p += 16;
+            continue;
+        }
+        const char* block_end = p + 16;
+        for (p += __builtin_ctz(mask); p < block_end;) {
+            const char* q = utf8_sequence(p, end);
+            if (!q)
+                return p;
+            p = q;
+        }
+    }
+    return validate_utf8_scalar(p, end);
+}
+
+// AVX2：同样的方法，一次32字节
+__attribute__((target("avx2")))
+static const char* skip_whitespace_avx2(const char* p, const char* end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, space), _mm256_cmpeq_epi8(x, tab)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(x, lf), _mm256_cmpeq_epi8(x, cr)));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(ws));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    return skip_whitespace_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* scan_string_avx2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i ctrl = _mm256_set1_epi8(0x1F);
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, quote), _mm256_cmpeq_epi8(x, backslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(x, ctrl), ctrl));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    return scan_string_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const char* p, Masks& m) {
+    m.quote = m.backslash = m.op = 0;
+    for (int k = 0; k < 64; k += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + k));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(']'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(',')))));
+        m.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"'))))) << k;
+        m.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\'))))) << k;
+        m.op |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << k;
+    }
+}
+
+/*
+    UTF-8的查表检查（Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"）：
+    每个字节和它前面的字节的高4位、前一个字节的低4位分别查一张16项的表（vpshufb），
+    每张表给出这一半字节可能属于的错误种类，三者相与不为0就是错误。
+    3字节和4字节序列中第3、4个字节是否应该是后续字节，通过向前2、3个字节是否为E0以上、F0以上判断。
+    只确定有没有错误，出错时从最后一个序列完整的位置开始用逐字节的实现找到具体位置，不足32字节的尾部也逐字节检查。
+*/
+enum : uint8_t {
+    TOO_SHORT = 1 << 0,      // 11______ 0_______ 或 11______ 11______
+    TOO_LONG = 1 << 1,       // 0_______ 10______
+    OVERLONG_3 = 1 << 2,     // 11100000 100_____
+    TOO_LARGE = 1 << 3,      // 11110100 1001____ 等
+    SURROGATE = 1 << 4,      // 11101101 101_____
+    OVERLONG_2 = 1 << 5,     // 1100000_ 10______
+    TOO_LARGE_1000 = 1 << 6, // 11110101 1000____ 等
+    OVERLONG_4 = 1 << 6,     // 11110000 1000____
+    TWO_CONTS = 1 << 7,      // 10______ 10______
+    CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS,
+};
+
+// input前面第n个字节，跨越128位的两半和上一个块
+#define MYJSON_PREV(input, prev, n) \
+    _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_errors(__m256i input, __m256i prev) {
+    const __m256i byte_1_high = _mm256_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const uint8_t L = CARRY | TOO_LARGE | TOO_LARGE_1000;
+    const __m256i byte_1_low = _mm256_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY, CARRY,
+        CARRY | TOO_LARGE, L, L, L, L, L, L, L, L, L | SURROGATE, L, L,
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY, CARRY,
+        CARRY | TOO_LARGE, L, L, L, L, L, L, L, L, L | SURROGATE, L, L);
+    const uint8_t C = TOO_LONG | OVERLONG_2 | TWO_CONTS;
+    const __m256i byte_2_high = _mm256_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        C | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4, C | OVERLONG_3 | TOO_LARGE,
+        C | SURROGATE | TOO_LARGE, C | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        C | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4, C | OVERLONG_3 | TOO_LARGE,
+        C | SURROGATE | TOO_LARGE, C | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i prev1 = MYJSON_PREV(input, prev, 1);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+    // 前面第2个字节是111_____或者第3个字节是1111____时，这个字节必须是后续字节
+    __m256i third = _mm256_subs_epu8(MYJSON_PREV(input, prev, 2), _mm256_set1_epi8(static_cast<char>(0xE0 - 1)));
+    __m256i fourth = _mm256_subs_epu8(MYJSON_PREV(input, prev, 3), _mm256_set1_epi8(static_cast<char>(0xF0 - 1)));
+    __m256i must_be_cont = _mm256_and_si256(
+        _mm256_cmpgt_epi8(_mm256_or_si256(third, fourth), _mm256_setzero_si256()),
+        _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must_be_cont, special);
+}
+
+#undef MYJSON_PREV
+
+// 块的最后3个字节中有没有还没结束的序列
+__attribute__((target("avx2")))
+static inline __m256i utf8_incomplete(__m256i input) {
+    const __m256i max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(input, max);
+}
+
+__attribute__((target("avx2")))
+static const char* validate_utf8_avx2(const char* p, const char* end) {
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    // good之前的部分已经确定合法，并且good是一个序列的开头
+    const char* good = p;
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i error;
+        if (!_mm256_movemask_epi8(x)) {
+            // 全是ASCII时只需要前一块的最后一个序列已经结束
+            error = incomplete;
+            incomplete = _mm256_setzero_si256();
+        } else {
+            error = utf8_errors(x, prev);
+            incomplete = utf8_incomplete(x);
+        }
+        prev = x;
+        if (!_mm256_testz_si256(error, error))
+            return validate_utf8_scalar(good, end);
+        if (_mm256_testz_si256(incomplete, incomplete))
+            good = p + 32;
+    }
+    // 不足32字节的尾部（连同前面没有结束的序列）逐字节检查
+    return validate_utf8_scalar(good, end);
+}
+
+#endif  // MYJSON_X86
+
+/*
+    运行时选择实现
+*/
+static const Kernels scalar_kernels = {"scalar", skip_whitespace_scalar, scan_string_scalar, classify_scalar,
+                                       validate_utf8_scalar};
+#ifdef MYJSON_X86
+static const Kernels sse2_kernels = {"sse2", skip_whitespace_sse2, scan_string_sse2, classify_sse2, validate_utf8_sse2};
+static const Kernels avx2_kernels = {"avx2", skip_whitespace_avx2, scan_string_avx2, classify_avx2, validate_utf8_avx2};
+#endif
+
+const Kernels* kernels_for(const char* name) {
+#ifdef MYJSON_X86
+    __builtin_cpu_init();
+    if (std::strcmp(name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2") ? &avx2_kernels : nullptr;
+    if (std::strcmp(name, "sse2") == 0)
+        return __builtin_cpu_supports("sse2") ? &sse2_kernels : nullptr;
+#endif
+    return std::strcmp(name, "scalar") == 0 ? &scalar_kernels : nullptr;
+}
+
+static Kernels select_kernels() {
+    const char* force = std::getenv("MYJSON_SIMD");
+    bool scalar = force && std::strcmp(force, "scalar") == 0;
+    bool sse2 = force && std::strcmp(force, "sse2") == 0;
+    const Kernels* k = nullptr;
+    if (!scalar && !sse2)
+        k = kernels_for("avx2");
+    if (!k && !scalar)
+        k = kernels_for("sse2");
+    return k ? *k : scalar_kernels;
+}
+
+static const Kernels& kernels() {
+    static const Kernels k = select_kernels();
+    return k;
+}
+
+const char* skip_whitespace(const char* p, const char* end) {
+    return kernels().skip_whitespace(p, end);
+}
+
+const char* scan_string(const char* p, const char* end) {
+    return kernels().scan_string(p, end);
+}
+
+void classify(const char* p, Masks& m) {
+    kernels().classify(p, m);
+}
+
+const char* validate_utf8(const char* p, const char* end) {
+    return kernels().validate_utf8(p, end);
+}
+
+const char* implementation() {
+    return kernels().name;
+}
+
+}  // namespace simd
+}  // namespace myjson
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/*
+    解析中最耗时的两种扫描：跳过空白，以及在字符串中找到下一个需要特殊处理的字符；另外还有UTF-8的检查。
+    这里提供AVX2、SSE2和逐字节三种实现，第一次使用时根据CPU选择，
+    也可以用环境变量MYJSON_SIMD=avx2/sse2/scalar强制指定（不会超过CPU支持的级别）。
+*/
+namespace myjson {
+namespace simd {
+
+// 返回[p, end)中第一个不是' '、'\t'、'\n'、'\r'的位置，没有则返回end
+const char* skip_whitespace(const char* p, const char* end);
+
+// 返回[p, end)中第一个'"'、'\\'或者小于0x20的控制字符的位置，没有则返回end
+const char* scan_string(const char* p, const char* end);
+
+// 64字节的块中几类字符的位图，第k位对应p[k]
+struct Masks {
+    uint64_t quote;      // '"'
+    uint64_t backslash;  // '\\'
+    uint64_t op;         // '{' '}' '[' ']' ':' ','
+};
+
+// 计算p开始的64字节的位图，p后面必须至少有64字节
+void classify(const char* p, Masks& m);
+
+// 检查[p, end)是否为合法的UTF-8（RFC 3629：不允许过长编码、代理项和超过U+10FFFF的码点），
+// 返回第一个非法序列的开头，全部合法时返回end
+const char* validate_utf8(const char* p, const char* end);
+
+// 当前使用的实现："avx2"、"sse2"或"scalar"
+const char* implementation();
+
+// 一种实现的全部函数
+struct Kernels {
+    const char* name;
+    const char* (*skip_whitespace)(const char*, const char*);
+    const char* (*scan_string)(const char*, const char*);
+    void (*classify)(const char*, Masks&);
+    const char* (*validate_utf8)(const char*, const char*);
+};
+
+// 按名字取得某一种实现，不认识的名字或CPU不支持时返回nullptr。用于比较不同实现的结果
+const Kernels* kernels_for(const char* name);
+
+}  // namespace simd
+}  // namespace myjson
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    解析的统计信息：用JsonParser::collect_stats()或Document::collect_stats()打开，
+    之后的每次解析都把数据累加到这里，需要按次统计时在两次解析之间调用reset()。
+    没有打开时每个统计点只多一次指针判断；编译时定义MYJSON_NO_STATS则完全去掉。
+    计时使用steady_clock，打开后每个字符串、数字和容器都会读两次时钟，本身有明显的开销。
+*/
+struct ParseStats {
+    size_t parses = 0;
+    size_t bytes = 0;               // 消耗的输入字节数
+    size_t nodes[6] = {};           // 按Json::Type统计的值的个数
+    size_t max_depth = 0;           // 数组和对象的最大嵌套深度
+    size_t allocations = 0;         // 堆上分配的次数（节点、字符串、数组和对象的存储、key）
+    size_t allocated_bytes = 0;     // 堆上分配的字节数
+    size_t arena_bytes = 0;         // 从Arena中分配的字节数
+    size_t escaped_strings = 0;     // 含有转义、需要解码的字符串（包括key）
+    uint64_t string_ns = 0;         // 解析字符串和key的时间
+    uint64_t number_ns = 0;         // 解析数字的时间
+    uint64_t container_ns = 0;      // 元素解析完后构造数组和对象的时间
+
+    void reset() { *this = ParseStats(); }
+
+    // 转换成Json，方便直接送进监控系统
+    Json to_json() const {
+        Json::object o;
+        o["parses"] = static_cast<uint64_t>(parses);
+        o["bytes"] = static_cast<uint64_t>(bytes);
+        const char* names[] = {"null", "bool", "number", "string", "array", "object"};
+        Json::object n;
+        for (int t = 0; t < 6; t++)
+            n[names[t]] = static_cast<uint64_t>(nodes[t]);
+        o["nodes"] = Json(std::move(n));
+        o["max_depth"] = static_cast<uint64_t>(max_depth);
+        o["allocations"] = static_cast<uint64_t>(allocations);
+        o["allocated_bytes"] = static_cast<uint64_t>(allocated_bytes);
+        o["arena_bytes"] = static_cast<uint64_t>(arena_bytes);
+        o["escaped_strings"] = static_cast<uint64_t>(escaped_strings);
+        o["string_ns"] = static_cast<uint64_t>(string_ns);
+        o["number_ns"] = static_cast<uint64_t>(number_ns);
+        o["container_ns"] = static_cast<uint64_t>(container_ns);
+        return Json(std::move(o));
+    }
+};
+
+}  // namespace myjson
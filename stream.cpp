@@ -0,0 +1,301 @@
+#include "stream.h"
+#include <cctype>
+#include <cstring>
+#include "number.h"
+#include "simd.h"
+
+namespace myjson {
+
+static inline bool is_whitespace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+static inline bool is_number_char(char ch) {
+    return (ch >= '0' && ch <= '9') || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E';
+}
+
+// 在值后面出现了多余的字符时，Json::parse()在不同的位置报告的错误
+State StreamParser::context_error() const {
+    if (stack.empty())
+        return JSON_PARSE_ROOT_NOT_SINGULAR;
+    return stack.back().is_object ? JSON_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+                                   : JSON_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+}
+
+void StreamParser::value(Json v) {
+    if (stack.empty()) {
+        root_ = std::move(v);
+        mode = DONE;
+        return;
+    }
+    Frame& top = stack.back();
+    if (top.is_object)
+        top.members[top.key] = std::move(v);
+    else if (stream_elements && stack.size() == 1)
+        ready.push_back(std::move(v));
+    else
+        top.elements.push_back(std::move(v));
+    mode = AFTER_VALUE;
+}
+
+bool StreamParser::start_value(char ch) {
+    switch (ch) {
+        case '[':
+        case '{':
+            if (stack.size() == default_max_depth) {
+                fail(JSON_PARSE_TOO_DEEP);
+                return false;
+            }
+            stack.push_back(Frame{ch == '{', Json::array(), Json::object(), string()});
+            mode = ch == '{' ? FIRST_KEY : FIRST_VALUE;
+            return true;
+        case '"':
+            token.assign(1, '"');
+            escaped = false;
+            token_is_key = false;
+            mode = STRING;
+            return true;
+        case 'n': literal = "null"; break;
+        case 't': literal = "true"; break;
+        case 'f': literal = "false"; break;
+        default:
+            if (ch != '-' && !(ch >= '0' && ch <= '9')) {
+                fail(JSON_PARSE_INVALID_VALUE);
+                return false;
+            }
+            token.assign(1, ch);
+            mode = NUMBER;
+            return true;
+    }
+    token.assign(1, ch);
+    mode = LITERAL;
+    return true;
+}
+
+// 字符串已经读到结尾的引号，交给JsonParser解码
+bool StreamParser::end_string() {
+    JsonParser parser(token.data(), token.size());
+    parser.get_next_token();
+    string s = parser.parse_string();
+    if (parser.failed) {
+        fail(parser.error);
+        return false;
+    }
+    if (token_is_key) {
+        stack.back().key = std::move(s);
+        mode = COLON;
+    } else {
+        value(Json(std::move(s)));
+    }
+    return true;
+}
+
+bool StreamParser::end_number() {
+    const char* p = token.data();
+    const char* end = p + token.size();
+    Number n;
+    State s = scan_number(p, end, n);
+    if (s != JSON_PARSE_OK) {
+        fail(s);
+        return false;
+    }
+    if (p != end) {
+        fail(context_error());
+        return false;
+    }
+    value(n.kind == Number::INT ? Json(n.i) : n.kind == Number::UINT ? Json(n.u) : Json(n.d));
+    return true;
+}
+
+bool StreamParser::close(bool is_object) {
+    Frame frame = std::move(stack.back());
+    stack.pop_back();
+    if (is_object)
+        value(Json(std::move(frame.members)));
+    else
+        value(Json(std::move(frame.elements)));
+    return true;
+}
+
+State StreamParser::feed(const char* data, size_t n) {
+    if (error != JSON_PARSE_OK)
+        return error;
+    const char* p = data;
+    const char* end = data + n;
+    while (p != end) {
+        char ch = *p;
+        switch (mode) {
+            case STRING: {
+                // 转义和控制字符在读到时就报错，不等到字符串结束；位置和JsonParser一样在这个字节之后
+                if (hex_left > 0) {
+                    if (!std::isxdigit(static_cast<unsigned char>(ch))) {
+                        consumed += p + 1 - data;
+                        return fail(JSON_PARSE_INVALID_UNICODE_HEX);
+                    }
+                    hex_left--;
+                    token += ch;
+                    p++;
+                    break;
+                }
+                if (escaped) {
+                    if (!std::strchr("\"\\/bfnrtu", ch) || ch == '\0') {
+                        consumed += p + 1 - data;
+                        return fail(JSON_PARSE_INVALID_STRING_ESCAPE);
+                    }
+                    escaped = false;
+                    hex_left = ch == 'u' ? 4 : 0;
+                    token += ch;
+                    p++;
+                    break;
+                }
+                const char* q = simd::scan_string(p, end);
+                token.append(p, q);
+                if (q == end) {
+                    p = q;
+                    break;
+                }
+                if (static_cast<unsigned char>(*q) < 0x20) {
+                    consumed += q + 1 - data;
+                    return fail(JSON_PARSE_INVALID_STRING_CHAR);
+                }
+                token += *q;
+                p = q + 1;
+                if (*q == '\\') {
+                    escaped = true;
+                } else if (*q == '"') {
+                    if (!end_string()) {
+                        consumed += p - data;
+                        return error;
+                    }
+                }
+                break;
+            }
+            case NUMBER:
+                if (is_number_char(ch)) {
+                    token += ch;
+                    p++;
+                } else if (!end_number()) {
+                    consumed += p - data;
+                    return error;
+                }
+                break;
+            case LITERAL:
+                if (ch != literal[token.size()]) {
+                    consumed += p - data;
+                    return fail(JSON_PARSE_INVALID_VALUE);
+                }
+                token += ch;
+                p++;
+                if (literal[token.size()] == '\0')
+                    value(literal[0] == 'n' ? Json() : Json(literal[0] == 't'));
+                break;
+            default: {
+                if (is_whitespace(ch)) {
+                    p = simd::skip_whitespace(p, end);
+                    break;
+                }
+                p++;
+                bool ok = true;
+                switch (mode) {
+                    case FIRST_VALUE:
+                        if (ch == ']') {
+                            ok = close(false);
+                            break;
+                        }
+                        // fall through
+                    case VALUE:
+                        ok = start_value(ch);
+                        break;
+                    case FIRST_KEY:
+                        if (ch == '}') {
+                            ok = close(true);
+                            break;
+                        }
+                        // fall through
+                    case KEY:
+                        if (ch == '"') {
+                            token.assign(1, '"');
+                            escaped = false;
+                            token_is_key = true;
+                            mode = STRING;
+                        } else {
+                            ok = false;
+                            fail(JSON_PARSE_MISS_KEY);
+                        }
+                        break;
+                    case COLON:
+                        if (ch == ':')
+                            mode = VALUE;
+                        else
+                            ok = false, fail(JSON_PARSE_MISS_COLON);
+                        break;
+                    case AFTER_VALUE: {
+                        bool is_object = stack.back().is_object;
+                        if (ch == ',')
+                            mode = is_object ? KEY : VALUE;
+                        else if (ch == (is_object ? '}' : ']'))
+                            ok = close(is_object);
+                        else
+                            ok = false, fail(context_error());
+                        break;
+                    }
+                    default:  // DONE
+                        ok = false;
+                        fail(JSON_PARSE_ROOT_NOT_SINGULAR);
+                        break;
+                }
+                if (!ok) {
+                    consumed += p - 1 - data;
+                    return error;
+                }
+            }
+        }
+    }
+    consumed += n;
+    return error;
+}
+
+State StreamParser::finish() {
+    if (error != JSON_PARSE_OK)
+        return error;
+    switch (mode) {
+        case DONE: return error;
+        case NUMBER: end_number(); return finish();
+        // 和Json::parse相同：停在转义或者\u的十六进制数字中间时报告转义的错误
+        case STRING:
+            if (hex_left > 0)
+                return fail(JSON_PARSE_INVALID_UNICODE_HEX);
+            return fail(escaped ? JSON_PARSE_INVALID_STRING_ESCAPE : JSON_PARSE_MISS_QUOTATION_MARK);
+        case LITERAL: return fail(JSON_PARSE_INVALID_VALUE);
+        case VALUE:
+        case FIRST_VALUE: return fail(JSON_PARSE_EXPECT_VALUE);
+        case KEY:
+        case FIRST_KEY: return fail(JSON_PARSE_MISS_KEY);
+        case COLON: return fail(JSON_PARSE_MISS_COLON);
+        case AFTER_VALUE: return fail(context_error());
+    }
+    return error;
+}
+
+bool StreamParser::next(Json& element) {
+    if (ready.empty())
+        return false;
+    element = std::move(ready.front());
+    ready.pop_front();
+    return true;
+}
+
+void StreamParser::reset() {
+    mode = VALUE;
+    error = JSON_PARSE_OK;
+    consumed = 0;
+    stack.clear();
+    token.clear();
+    escaped = false;
+    hex_left = 0;
+    literal = nullptr;
+    root_ = Json();
+    ready.clear();
+}
+
+}  // namespace myjson
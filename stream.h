@@ -0,0 +1,68 @@
+#pragma once
+#include <deque>
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    增量解析：输入可以被切成任意大小的块，依次交给feed()，解析状态（包括字符串、\u转义和数字的中间状态）
+    在两次feed()之间保留，不需要先把整个输入读进内存。
+    输入结束后调用finish()，顶层的数字这样没有结束符的值要到finish()时才能确定。
+    stream_elements为true并且根是数组时，根数组的每个元素一旦完成就可以用next()取出，
+    不会留在根数组中，这样解析很大的数组时占用的内存只和单个元素的大小有关。
+    错误码和Json::parse()相同，嵌套深度同样不能超过default_max_depth。
+*/
+class StreamParser final {
+public:
+    explicit StreamParser(bool stream_elements = false) : stream_elements(stream_elements) {}
+
+    State feed(const char* data, size_t n);
+    State feed(const string& data) { return feed(data.data(), data.size()); }
+    State finish();
+
+    // 根值是否已经完整解析
+    bool complete() const { return mode == DONE && error == JSON_PARSE_OK; }
+    // 取出一个已经完成的根数组元素，没有时返回false
+    bool next(Json& element);
+    // 完整解析后的根值，stream_elements时已经取出的元素不在其中
+    const Json& root() const { return root_; }
+    State state() const { return error; }
+    // 已经消费的字节数，出错时就是出错的位置
+    size_t offset() const { return consumed; }
+
+    void reset();
+
+private:
+    enum Mode { VALUE, FIRST_VALUE, AFTER_VALUE, KEY, FIRST_KEY, COLON, STRING, NUMBER, LITERAL, DONE };
+
+    struct Frame {
+        bool is_object;
+        Json::array elements;
+        Json::object members;
+        string key;
+    };
+
+    void value(Json v);
+    bool start_value(char ch);
+    bool end_string();
+    bool end_number();
+    bool close(bool is_object);
+    State fail(State s) { error = s; return s; }
+    State context_error() const;
+
+    bool stream_elements;
+    Mode mode = VALUE;
+    State error = JSON_PARSE_OK;
+    size_t consumed = 0;
+    std::vector<Frame> stack;
+    // 未完成的字符串（包括开头的引号和未解码的转义）、数字或者字面量
+    string token;
+    bool escaped = false;
+    int hex_left = 0;       // \u之后还要读的十六进制数字个数
+    const char* literal = nullptr;
+    bool token_is_key = false;
+    Json root_;
+    std::deque<Json> ready;
+};
+
+}  // namespace myjson
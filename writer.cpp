@@ -0,0 +1,186 @@
+#include "writer.h"
+#include "dump.h"
+#include <unistd.h>
+#include <cerrno>
+
+namespace myjson {
+
+Writer::Writer(string& out, int indent) : buf(out), start(out.size()), indent(indent) {}
+
+Writer::Writer(int fd, int indent) : Writer(Sink([fd](const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}), indent) {}
+
+Writer::Writer(Sink sink, int indent) : buf(own), start(0), sink(std::move(sink)), indent(indent) {
+    own.reserve(writer_block_size + writer_block_size / 4);
+}
+
+State Writer::flush() {
+    if (!sink || buf.empty())
+        return error;
+    if (error == JSON_PARSE_OK && !sink(buf.data(), buf.size()))
+        error = JSON_PARSE_IO_ERROR;
+    flushed += buf.size();
+    buf.clear();
+    return error;
+}
+
+// debug构建中检查嵌套，release构建中什么也不做
+void Writer::check_open(char kind) {
+#ifndef NDEBUG
+    open.push_back(kind);
+#else
+    (void)kind;
+#endif
+}
+
+void Writer::check_close(char kind) {
+#ifndef NDEBUG
+    assert(!open.empty() && open.back() == kind && !after_key);
+    open.pop_back();
+#else
+    (void)kind;
+#endif
+}
+
+// 值之前的逗号和缩进；根上的多个值之间用换行分隔
+void Writer::separator() {
+#ifndef NDEBUG
+    assert(open.empty() || open.back() == '[' || after_key);
+#endif
+    if (after_key) {
+        after_key = false;
+        return;
+    }
+    if (depth == 0) {
+        if (!first)
+            buf += '\n';
+        return;
+    }
+    if (!first)
+        buf += ',';
+    if (indent > 0)
+        newline(depth);
+}
+
+Writer& Writer::begin_object() {
+    separator();
+    check_open('{');
+    buf += '{';
+    depth++;
+    first = true;
+    return *this;
+}
+
+Writer& Writer::end_object() {
+    check_close('{');
+    depth--;
+    if (indent > 0 && !first)
+        newline(depth);
+    buf += '}';
+    after_value();
+    return *this;
+}
+
+Writer& Writer::begin_array() {
+    separator();
+    check_open('[');
+    buf += '[';
+    depth++;
+    first = true;
+    return *this;
+}
+
+Writer& Writer::end_array() {
+    check_close('[');
+    depth--;
+    if (indent > 0 && !first)
+        newline(depth);
+    buf += ']';
+    after_value();
+    return *this;
+}
+
+Writer& Writer::key(StringView k) {
+#ifndef NDEBUG
+    assert(!open.empty() && open.back() == '{' && !after_key);
+#endif
+    if (!first)
+        buf += ',';
+    if (indent > 0)
+        newline(depth);
+    dump_string(k.data(), k.size(), buf);
+    buf += ':';
+    if (indent > 0)
+        buf += ' ';
+    after_key = true;
+    return *this;
+}
+
+Writer& Writer::null() {
+    separator();
+    buf.append("null", 4);
+    after_value();
+    return *this;
+}
+
+Writer& Writer::value(bool b) {
+    separator();
+    if (b) buf.append("true", 4);
+    else buf.append("false", 5);
+    after_value();
+    return *this;
+}
+
+Writer& Writer::value(int64_t i) {
+    separator();
+    dump_number(i, buf);
+    after_value();
+    return *this;
+}
+
+Writer& Writer::value(uint64_t u) {
+    separator();
+    dump_number(u, buf);
+    after_value();
+    return *this;
+}
+
+Writer& Writer::value(double d) {
+    separator();
+    dump_number(d, buf);
+    after_value();
+    return *this;
+}
+
+Writer& Writer::value(StringView s) {
+    separator();
+    dump_string(s.data(), s.size(), buf);
+    after_value();
+    return *this;
+}
+
+Writer& Writer::value(const Json& json) {
+    separator();
+    dump_value(json, buf, indent, false, depth);
+    after_value();
+    return *this;
+}
+
+Writer& Writer::raw(StringView json) {
+    separator();
+    buf.append(json.data(), json.size());
+    after_value();
+    return *this;
+}
+
+}  // namespace myjson
@@ -0,0 +1,92 @@
+#pragma once
+#include <functional>
+#include <type_traits>
+#include "myjson.h"
+
+namespace myjson {
+
+/*
+    Writer：不构造Json，直接按顺序输出JSON文本。
+        Writer w(fd);
+        w.begin_object().key("id").value(1).key("tags").begin_array().value("a").end_array().end_object();
+    输出先放在缓冲区中，超过writer_block_size时整块交给目标：追加到string、写入文件描述符或者交给sink。
+    追加到string时没有中间的缓冲区。析构时自动flush()，需要检查写入错误时应该显式调用flush()。
+    字符串的转义和数字的格式和Json::dump()相同；indent大于0时的缩进格式也相同。
+    在根上连续输出多个值时，值之间用换行分隔（NDJSON）。
+    begin/end是否配对、key和值是否交替只在debug构建（没有定义NDEBUG）中用assert检查。
+*/
+const size_t writer_block_size = 64 * 1024;
+
+class Writer {
+public:
+    // 写入失败时返回false
+    typedef std::function<bool(const char* data, size_t len)> Sink;
+
+    explicit Writer(string& out, int indent = 0);
+    explicit Writer(int fd, int indent = 0);
+    explicit Writer(Sink sink, int indent = 0);
+    ~Writer() { flush(); }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    Writer& begin_object();
+    Writer& end_object();
+    Writer& begin_array();
+    Writer& end_array();
+    // 对象成员的key，后面必须紧跟一个值
+    Writer& key(StringView k);
+
+    Writer& null();
+    Writer& value(bool b);
+    Writer& value(int64_t i);
+    Writer& value(uint64_t u);
+    // 其他整数类型（int、unsigned、long long等）按有无符号转换为int64_t或者uint64_t
+    template <typename T,
+              typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    Writer& value(T i) {
+        return std::is_signed<T>::value ? value(static_cast<int64_t>(i)) : value(static_cast<uint64_t>(i));
+    }
+    Writer& value(double d);
+    Writer& value(StringView s);
+    Writer& value(const char* s) { return value(StringView(s)); }
+    Writer& value(const string& s) { return value(StringView(s)); }
+    // 已经构造好的Json整个输出，对象的成员按照原来的顺序
+    Writer& value(const Json& json);
+    // 已经是JSON文本的值原样输出，不做检查
+    Writer& raw(StringView json);
+
+    // 把缓冲区中的内容交给目标，返回JSON_PARSE_OK或者JSON_PARSE_IO_ERROR。出错之后的输出都被丢弃
+    State flush();
+    State state() const { return error; }
+    // 已经输出的字节数，包括还在缓冲区中的部分
+    size_t bytes() const { return flushed + buf.size() - start; }
+
+private:
+    void separator();
+    void after_value() {
+        first = false;
+        if (sink && buf.size() >= writer_block_size)
+            flush();
+    }
+    void newline(int level) {
+        buf += '\n';
+        buf.append(static_cast<size_t>(level) * indent, ' ');
+    }
+    void check_open(char kind);
+    void check_close(char kind);
+
+    string own;
+    string& buf;                // 输出到string时就是那个string，否则是own
+    size_t start;               // 输出到string时，开始时string中已有的内容不计入bytes()
+    Sink sink;
+    int indent;
+    int depth = 0;
+    bool first = true;          // 当前容器中还没有元素
+    bool after_key = false;     // 刚输出了key，下一个必须是值
+    size_t flushed = 0;
+    State error = JSON_PARSE_OK;
+    std::vector<char> open;     // 未结束的容器，只在debug构建中使用
+};
+
+}  // namespace myjson